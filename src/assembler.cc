@@ -2,6 +2,14 @@
 #include "network.hh"
 #include "nodes.hh"
 #include "edge.hh"
+#include <QStringList>
+#include <QVector>
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 
 /* ********************************************************************************************* *
@@ -47,107 +55,650 @@ MessageBuilder::~MessageBuilder() {
 }
 
 
+/* ********************************************************************************************* *
+ * Implementation of Term
+ * ********************************************************************************************* */
+Term::Term()
+  : _null(true), _shift(0), _hasNormal(false), _mu(0), _variance(0), _gammas(), _parts()
+{
+  // pass...
+}
+
+Term::Term(const stochbb::Var &var)
+  : _null(true), _shift(0), _hasNormal(false), _mu(0), _variance(0), _gammas(), _parts()
+{
+  if (! var.isNull())
+    *this = part(VARIABLE, 0, 0, var);
+}
+
+Term::Term(const Term &other)
+  : _null(other._null), _shift(other._shift), _hasNormal(other._hasNormal), _mu(other._mu),
+    _variance(other._variance), _gammas(other._gammas), _parts(other._parts)
+{
+  // pass...
+}
+
+Term &
+Term::operator =(const Term &other) {
+  _null      = other._null;
+  _shift     = other._shift;
+  _hasNormal = other._hasNormal;
+  _mu        = other._mu;
+  _variance  = other._variance;
+  _gammas    = other._gammas;
+  _parts     = other._parts;
+  return *this;
+}
+
+Term
+Term::delta(double value) {
+  Term term;
+  term._null = false;
+  term._shift = value;
+  return term;
+}
+
+Term
+Term::normal(double mu, double sigma) {
+  Term term;
+  term._null = false;
+  term._hasNormal = true;
+  term._mu = mu;
+  term._variance = sigma*sigma;
+  return term;
+}
+
+Term
+Term::gamma(double k, double theta) {
+  Term term;
+  term._null = false;
+  term._gammas.append(QPair<double, double>(k, theta));
+  return term;
+}
+
+Term
+Term::invgamma(double alpha, double beta) {
+  return part(INVGAMMA, alpha, beta);
+}
+
+Term
+Term::weibull(double k, double lambda) {
+  return part(WEIBULL, k, lambda);
+}
+
+Term
+Term::uniform(double a, double b) {
+  return part(UNIFORM, a, b);
+}
+
+Term
+Term::part(PartType type, double a, double b, const stochbb::Var &var) {
+  Part part;
+  part.type = type; part.a = a; part.b = b;
+  part.scale = 1; part.var = var;
+  Term term;
+  term._null = false;
+  term._parts.append(part);
+  return term;
+}
+
+double
+Term::width(const Part &part) {
+  // Estimates the width of the support of a part by its standard deviation
+  double w = std::numeric_limits<double>::infinity();
+  switch (part.type) {
+  case GAMMA:
+    w = std::sqrt(part.a)*part.b;
+    break;
+  case INVGAMMA:
+    if (part.a > 2)
+      w = part.b/((part.a-1)*std::sqrt(part.a-2));
+    break;
+  case WEIBULL:
+    w = part.b*std::sqrt(std::tgamma(1+2/part.a) - std::pow(std::tgamma(1+1/part.a), 2));
+    break;
+  case UNIFORM:
+    w = (part.b-part.a)/std::sqrt(12.);
+    break;
+  case SUM:
+    w = part.a;
+    break;
+  case VARIABLE:
+    break;
+  }
+  return std::abs(part.scale)*w;
+}
+
+int
+Term::count(const Part &part) {
+  // A sum part keeps the number of parts it was merged from
+  return (SUM == part.type) ? int(part.b) : 1;
+}
+
+stochbb::Var
+Term::create(const Part &part) {
+  // Parametric parts are created anew, plain variables and sums are reused
+  switch (part.type) {
+  case GAMMA: return stochbb::gamma(part.a, part.b);
+  case INVGAMMA: return stochbb::invgamma(part.a, part.b);
+  case WEIBULL: return stochbb::weibull(part.a, part.b);
+  case UNIFORM: return stochbb::uniform(part.a, part.b);
+  case VARIABLE:
+  case SUM:
+    break;
+  }
+  return part.var;
+}
+
+void
+Term::compact() {
+  // Merge parts pairwise into sums of equally many parts, like the carry of a binary counter.
+  // The sums are materialized once and shared with all terms folding this one. Hence a chain
+  // of N nodes creates O(N log N) variables instead of O(N^2), every term keeps O(log N)
+  // parts and the nesting depth of the final variable stays logarithmic.
+  // This trades the order by width for sharing: Pairing strictly the narrowest parts (like a
+  // Huffman tree) would regroup all summands at every node of the chain, such that no sum could
+  // be reused downstream. Hence, width only decides among parts of equal count, here and for
+  // the O(log N) remaining parts in var().
+  while (_parts.size() > 1) {
+    std::stable_sort(_parts.begin(), _parts.end(), [](const Part &a, const Part &b) {
+      return (count(a) < count(b)) || ((count(a) == count(b)) && (width(a) < width(b))); });
+    int i = 0;
+    while (((i+1) < _parts.size()) && (count(_parts[i]) != count(_parts[i+1])))
+      i++;
+    if ((i+1) >= _parts.size())
+      return;
+    Part a = _parts.takeAt(i), b = _parts.takeAt(i);
+    // Convolve the narrower part first
+    if (width(b) < width(a))
+      std::swap(a, b);
+    stochbb::Var va = create(a), vb = create(b);
+    Part sum;
+    sum.type = SUM; sum.scale = 1;
+    sum.a = std::sqrt(width(a)*width(a) + width(b)*width(b));
+    sum.b = count(a) + count(b);
+    sum.var = stochbb::chain(std::vector<stochbb::Var>{
+                               (1 == a.scale) ? va : stochbb::affine(va, a.scale, 0),
+                               (1 == b.scale) ? vb : stochbb::affine(vb, b.scale, 0)});
+    _parts.append(sum);
+  }
+}
+
+bool
+Term::isNull() const {
+  return _null;
+}
+
+Term
+Term::operator +(const Term &other) const {
+  if (_null || other._null)
+    return Term();
+
+  // The closed-form parts of both terms are independent, hence
+  //  delta(a) + delta(b) = delta(a+b),
+  //  N(mu1, s1^2) + N(mu2, s2^2) = N(mu1+mu2, s1^2+s2^2) and
+  //  Gamma(k1, theta) + Gamma(k2, theta) = Gamma(k1+k2, theta).
+  Term res(*this);
+  res._shift += other._shift;
+  if (other._hasNormal) {
+    res._mu += other._mu;
+    res._variance += other._variance;
+    res._hasNormal = true;
+  }
+  for (int i=0; i<other._gammas.size(); i++) {
+    int j=0;
+    while ((j<res._gammas.size()) && (res._gammas[j].second != other._gammas[i].second))
+      j++;
+    if (j<res._gammas.size())
+      res._gammas[j].first += other._gammas[i].first;
+    else
+      res._gammas.append(other._gammas[i]);
+  }
+  res._parts.append(other._parts);
+  res.compact();
+  return res;
+}
+
+Term
+Term::affine(double scale, double shift) const {
+  if (_null)
+    return Term();
+  if (0 == scale)
+    return Term::delta(shift);
+
+  Term res(*this);
+  res._shift = scale*_shift + shift;
+  res._mu *= scale;
+  res._variance *= scale*scale;
+  if (scale > 0) {
+    for (int i=0; i<res._gammas.size(); i++)
+      res._gammas[i].second *= scale;
+  } else {
+    // A gamma variable with negative scale is not closed-form, keep it as a separate part.
+    for (int i=0; i<res._gammas.size(); i++)
+      res._parts.append(part(GAMMA, res._gammas[i].first, res._gammas[i].second)._parts);
+    res._gammas.clear();
+  }
+  for (int i=0; i<res._parts.size(); i++)
+    res._parts[i].scale *= scale;
+  return res;
+}
+
+stochbb::Var
+Term::var(const QString &name) const {
+  if (_null)
+    return stochbb::Var();
+
+  // Collect all summands with their width and scale. Except for plain variables and the sums
+  // shared with folded sources, all summands are created here.
+  QList< QPair<double, Part> > parts;
+  if (_hasNormal) {
+    Part p; p.type = VARIABLE; p.scale = 1;
+    p.var = stochbb::normal(_mu, std::sqrt(_variance));
+    parts.append(QPair<double, Part>(std::sqrt(_variance), p));
+  }
+  for (int i=0; i<_gammas.size(); i++) {
+    Part p; p.type = GAMMA; p.a = _gammas[i].first; p.b = _gammas[i].second; p.scale = 1;
+    p.var = stochbb::gamma(p.a, p.b);
+    parts.append(QPair<double, Part>(width(p), p));
+  }
+  for (int i=0; i<_parts.size(); i++) {
+    Part p = _parts[i];
+    p.var = create(p);
+    parts.append(QPair<double, Part>(width(p), p));
+  }
+
+  // A delta only shifts the sum, hence no convolution is needed. The result is always a
+  // new variable, such that naming it does not rename any of the input variables.
+  stochbb::Var res;
+  if (0 == parts.size()) {
+    res = stochbb::delta(_shift);
+  } else if (1 == parts.size()) {
+    // Plain variables and sums, which may be shared with other terms, need to be wrapped. All
+    // other parts are new variables.
+    const Part &p = parts.first().second;
+    bool created = ((VARIABLE != p.type) && (SUM != p.type)) || _hasNormal;
+    if (created && (1 == p.scale) && (0 == _shift))
+      res = p.var;
+    else
+      res = stochbb::affine(p.var, p.scale, _shift);
+  } else {
+    // Sum the parts as a balanced tree, starting with the narrowest ones. This keeps the
+    // intermediate supports small and the recursion depth logarithmic.
+    std::stable_sort(parts.begin(), parts.end(),
+                     [](const QPair<double, Part> &a, const QPair<double, Part> &b) {
+      return a.first < b.first; });
+    std::vector<stochbb::Var> level;
+    for (int i=0; i<parts.size(); i++) {
+      const Part &p = parts[i].second;
+      level.push_back((1 == p.scale) ? p.var : stochbb::affine(p.var, p.scale, 0));
+    }
+    while (level.size() > 1) {
+      std::vector<stochbb::Var> next;
+      for (size_t i=0; i<level.size(); i+=2) {
+        if ((i+1) < level.size())
+          next.push_back(stochbb::chain(std::vector<stochbb::Var>{level[i], level[i+1]}));
+        else
+          next.push_back(level[i]);
+      }
+      level.swap(next);
+    }
+    res = level.front();
+    if (0 != _shift)
+      res = stochbb::affine(res, 1, _shift);
+  }
+  res.setName(name.toStdString());
+  return res;
+}
+
+
 /* ********************************************************************************************* *
  * Implementation of Assembler
  * ********************************************************************************************* */
-Assembler::Assembler(Network *net, QHash<Socket *, stochbb::Var> &varTable)
-  : _network(net), _queue(), _varTable(varTable), _processedNodes()
+Assembler::Assembler(Network *net, QHash<Socket *, stochbb::Var> &varTable,
+                     QHash<Socket *, Term> &termTable)
+  : _network(net), _nodes(), _varTable(varTable), _sources(varTable),
+    _termTable(termTable), _sourceTerms(termTable)
 {
-  // Prepare processing queue
+  // Collect nodes to process
   Network::nodeIterator item = net->nodesBegin();
   for (; item != net->nodesEnd(); item++) {
     if (NodeBase *node = dynamic_cast<NodeBase *>(*item))
-      _queue.append(node);
+      _nodes.append(node);
     else
       msgWarn(_messages) << "Cannot cast QNetNode node to NodeBase.";
   }
 }
 
+Assembler::Assembler(const Assembler &parent, QHash<Socket *, stochbb::Var> &varTable,
+                     QHash<Socket *, Term> &termTable)
+  : _network(parent._network), _nodes(), _varTable(varTable), _sources(parent._varTable),
+    _termTable(termTable), _sourceTerms(parent._termTable)
+{
+  // pass...
+}
+
 bool
-Assembler::assemble() {
-  bool progress = false;
-  do {
-    // Flag if some progress has been made
-    // this flag is used to detect unresolvable dependencies
-    progress = false;
-
-    // Iterate over queue
-    Queue::iterator item = _queue.begin();
-    while (item != _queue.end())
-    {
-      // get node to be processed
-      NodeBase *node = *item;
-
-      // if node has been processed already -> remove from queue and continue
-      if (_processedNodes.contains(node)) {
-        item = _queue.erase(item);
-        progress = true;
-        continue;
-      }
+Assembler::sort(QList<NodeBase *> &order) {
+  // Derive the dependency graph between the nodes. For every node, count the number of
+  // nodes it depends on and collect the nodes depending on it.
+  QHash<NodeBase *, int> indegree;
+  QHash<NodeBase *, QList<NodeBase *> > dependents;
+  _dependencies.clear();
+  foreach (NodeBase *node, _nodes)
+    indegree.insert(node, 0);
 
-      // Check if node needs pre-processing
-      if (node->needsPreprocessing(*this)) {
-        if (! node->preprocess(*this))
-          return false;
+  bool connected = true;
+  foreach (NodeBase *node, _nodes) {
+    QSet<NodeBase *> deps;
+    foreach (Socket *input, node->inputs()) {
+      NodeBase *src = 0;
+      if (Socket *source = _network->findSource(input))
+        src = dynamic_cast<NodeBase *>(source->parent());
+      // If the node reads inputs of another node (i.e., its sibling), it depends on that node too
+      if (input->parent() != node) {
+        if (NodeBase *owner = dynamic_cast<NodeBase *>(input->parent()))
+          deps.insert(owner);
+      }
+      if (src) {
+        deps.insert(src);
+      } else if (input->parent() == node) {
+        // Report unconnected inputs of the node itself only, inputs of siblings
+        // get reported with their owner
+        msgError(_messages) << "Input '" << input->name() << "' of node "
+                            << node->label() << " is not connected.";
+        connected = false;
       }
+    }
+    foreach (NodeBase *dep, deps) {
+      if (! indegree.contains(dep))
+        continue;
+      indegree[node]++;
+      _dependencies[node].append(dep);
+      dependents[dep].append(node);
+    }
+  }
+  if (! connected)
+    return false;
+
+  // Kahn's algorithm: start with all nodes without dependencies and release
+  // the dependents of each processed node.
+  QList<NodeBase *> ready;
+  foreach (NodeBase *node, _nodes) {
+    if (0 == indegree[node])
+      ready.append(node);
+  }
+  order.clear(); order.reserve(_nodes.size());
+  while (ready.size()) {
+    NodeBase *node = ready.takeFirst();
+    order.append(node);
+    foreach (NodeBase *dep, dependents.value(node)) {
+      if (0 == --indegree[dep])
+        ready.append(dep);
+    }
+  }
+
+  if (order.size() == _nodes.size())
+    return true;
+
+  // There are circular dependencies. The remaining nodes are either part of a cycle or
+  // depend on one. Strip the latter by running Kahn's algorithm backwards on the remaining
+  // nodes, what is left are exactly the nodes forming the cycles.
+  QHash<NodeBase *, int> outdegree;
+  foreach (NodeBase *node, _nodes) {
+    if (indegree[node] > 0)
+      outdegree.insert(node, 0);
+  }
+  foreach (NodeBase *node, outdegree.keys()) {
+    foreach (NodeBase *dep, _dependencies.value(node)) {
+      if (outdegree.contains(dep))
+        outdegree[dep]++;
+    }
+  }
+  foreach (NodeBase *node, outdegree.keys()) {
+    if (0 == outdegree[node])
+      ready.append(node);
+  }
+  QSet<NodeBase *> remaining = outdegree.keys().toSet();
+  while (ready.size()) {
+    NodeBase *node = ready.takeFirst();
+    remaining.remove(node);
+    foreach (NodeBase *dep, _dependencies.value(node)) {
+      if (remaining.contains(dep) && (0 == --outdegree[dep]))
+        ready.append(dep);
+    }
+  }
+
+  QStringList labels;
+  foreach (NodeBase *node, _nodes) {
+    if (remaining.contains(node))
+      labels.append(node->label());
+  }
+  msgError(_messages) << "Cannot process network. Circular dependency between the nodes "
+                      << labels.join(", ") << ".";
+  return false;
+}
+
+bool
+Assembler::assemble() {
+  return assemble(_nodes.toSet(), SERIAL);
+}
+
+bool
+Assembler::assemble(const QSet<NodeBase *> &invalid, Mode mode) {
+  QList<NodeBase *> order;
+  if (! sort(order))
+    return false;
 
-      // Check if all nodes, this node depends on has been processed
-      if (node->processable(*this)) {
-        // try process node, on error -> fail
-        try {
-          if(! node->assemble(*this)) {
-            msgError(_messages) << "Cannot process node " << node->label() << ".";
-            return false;
-          }
-        } catch (stochbb::Error &error) {
-          msgError(_messages) << "Cannot process node " << node->label() << ": "
-                              << error.str().c_str() << ".";
-          return false;
-        }
-        // on success, remove node from queue
-        item = _queue.erase(item);
-        // add node to processed nodes
-        _processedNodes.insert(node);
-        // flag that some progress has been made
-        progress = true;
-      } else {
-        // if node cannot be processed yet -> continue
-        item++;
+  // Collect the invalidated nodes and all nodes depending on them. As the nodes are
+  // traversed in topological order, all dependencies of a node are visited before the node.
+  // Also assign each node of that cone a level, such that all dependencies of a node are
+  // on lower levels. Hence all nodes of the same level can be assembled independently.
+  QList<NodeBase *> &cone = _cone;
+  QHash<NodeBase *, int> levels;
+  int nlevels = 0;
+  foreach (NodeBase *node, order) {
+    bool dirty = invalid.contains(node);
+    int level = 0;
+    foreach (NodeBase *dep, _dependencies.value(node)) {
+      if (levels.contains(dep)) {
+        dirty = true;
+        level = std::max(level, levels[dep]+1);
       }
     }
-    // continue as long as we make progress
-  } while (progress);
-
-  // If not progress has been made and the queue is empty
-  // -> we are stuck, e.g. due to circular dependencies
-  if (_queue.size()) {
-    msgError(_messages) << "Cannot process network. Some dependencies cannot be resolved. "
-                        << "This is usually due to unconnected inputs or circular dependencies "
-                        << "between nodes.";
-    // Stuck...
+    if (dirty) {
+      cone.append(node);
+      levels.insert(node, level);
+      nlevels = std::max(nlevels, level+1);
+    }
+  }
+
+  // Remove the variables of all nodes that get re-assembled
+  foreach (NodeBase *node, cone) {
+    foreach (Socket *sock, node->sockets()) {
+      _varTable.remove(sock);
+      _termTable.remove(sock);
+    }
+  }
+
+  if (SERIAL == mode) {
+    foreach (NodeBase *node, cone) {
+      updateInputs(node);
+      if (! assemble(node))
+        return false;
+    }
+    return true;
+  }
+
+  // Group nodes by level, keeping the topological order within each level
+  QVector< QList<NodeBase *> > wavefronts(nlevels);
+  foreach (NodeBase *node, cone)
+    wavefronts[levels[node]].append(node);
+
+  foreach (const QList<NodeBase *> &wavefront, wavefronts) {
+    foreach (NodeBase *node, wavefront)
+      updateInputs(node);
+    if (! assemble(wavefront))
+      return false;
+  }
+
+  return true;
+}
+
+void
+Assembler::updateInputs(NodeBase *node) {
+  // Pick up the variables of all inputs, the sources may have been kept from a previous run
+  foreach (Socket *input, node->inputs()) {
+    Socket *src = _network->findSource(input);
+    if (src && _varTable.contains(src))
+      _varTable.insert(input, _varTable[src]);
+  }
+}
+
+bool
+Assembler::assemble(NodeBase *node) {
+  // Check if node needs pre-processing
+  if (node->needsPreprocessing(*this)) {
+    if (! node->preprocess(*this))
+      return false;
+  }
+
+  // try process node, on error -> fail
+  try {
+    if(! node->assemble(*this)) {
+      msgError(_messages) << "Cannot process node " << node->label() << ".";
+      return false;
+    }
+  } catch (stochbb::Error &error) {
+    msgError(_messages) << "Cannot process node " << node->label() << ": "
+                        << error.str().c_str() << ".";
     return false;
   }
 
   return true;
 }
 
+bool
+Assembler::assemble(const QList<NodeBase *> &wavefront) {
+  if (1 == wavefront.size())
+    return assemble(wavefront.first());
+
+  // Assemble all nodes of the wavefront concurrently. Each node gets its own assembler,
+  // reading from the shared variable table and collecting its results separately.
+  QVector<Job> jobs(wavefront.size());
+  for (int i=0; i<wavefront.size(); i++)
+    jobs[i].node = wavefront[i];
+  QtConcurrent::blockingMap(jobs, [this](Job &job) {
+    Assembler ass(*this, job.variables, job.terms);
+    job.success = ass.assemble(job.node);
+    job.messages = ass.messages();
+  });
+
+  // Merge the results in the order of the wavefront
+  bool success = true;
+  foreach (const Job &job, jobs) {
+    _messages.append(job.messages);
+    success = success && job.success;
+    QHash<Socket *, stochbb::Var>::const_iterator item = job.variables.begin();
+    for (; item != job.variables.end(); item++)
+      _varTable.insert(item.key(), item.value());
+    QHash<Socket *, Term>::const_iterator term = job.terms.begin();
+    for (; term != job.terms.end(); term++)
+      _termTable.insert(term.key(), term.value());
+  }
+
+  return success;
+}
+
 bool
 Assembler::assemble(Network *net, QHash<Socket *, stochbb::Var> &varTable) {
-  Assembler ass(net, varTable);
+  QHash<Socket *, Term> termTable;
+  Assembler ass(net, varTable, termTable);
   return ass.assemble();
 }
 
 bool
 Assembler::assemble(Network *net, QHash<Socket *, stochbb::Var> &varTable, Messages &messages) {
-  Assembler ass(net, varTable);
+  QHash<Socket *, Term> termTable;
+  Assembler ass(net, varTable, termTable);
   bool res = ass.assemble();
   messages = ass.messages();
   return res;
 }
 
+bool
+Assembler::update(Network *net, QHash<Socket *, stochbb::Var> &varTable,
+                  QHash<Socket *, Term> &termTable, QHash<Socket *, quint64> &hashTable,
+                  QSet<NodeBase *> &invalid, Messages &messages, Mode mode)
+{
+  Assembler ass(net, varTable, termTable);
+  bool res = ass.assemble(invalid, mode);
+  messages = ass.messages();
+  foreach (NodeBase *node, ass._cone) {
+    foreach (Socket *sock, node->sockets())
+      hashTable.remove(sock);
+  }
+  // On success, all nodes are up to date. Otherwise keep the invalidated nodes
+  // to retry them with the next update.
+  if (res) {
+    foreach (NodeBase *node, ass._cone)
+      ass.updateHashes(node, hashTable);
+    invalid.clear();
+  }
+  return res;
+}
+
+void
+Assembler::updateHashes(NodeBase *node, QHash<Socket *, quint64> &hashTable) {
+  // The hash of an output socket is derived from the node type, its parameters, the
+  // socket name and the hashes of all sources connected to the inputs of the node. Hence
+  // structurally identical sub-networks get the same hash.
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  hash.addData(node->metaObject()->className());
+  QStringList names = node->parameters().keys(); names.sort();
+  foreach (QString name, names) {
+    hash.addData(name.toUtf8());
+    hash.addData(QByteArray::number(node->parameter(name).type()));
+    hash.addData(node->parameter(name).asString().toUtf8());
+  }
+
+  std::vector<stochbb::Var> inputs;
+  foreach (Socket *input, node->inputs()) {
+    quint64 h = hashTable.value(_network->findSource(input), 0);
+    hash.addData((const char *) &h, sizeof(quint64));
+    inputs.push_back(_varTable.value(input));
+  }
+
+  // The marginal distribution of the node is only determined by the marginal distributions
+  // of its inputs if they are mutually independent. Otherwise, bind the hash to this node.
+  bool independent = true;
+  for (size_t i=0; independent && (i<inputs.size()); i++) {
+    for (size_t j=i+1; independent && (j<inputs.size()); j++) {
+      if (inputs[i].isNull() || inputs[j].isNull())
+        continue;
+      independent = inputs[i].mutuallyIndep(inputs[j]);
+    }
+  }
+  if (! independent) {
+    quintptr ptr = quintptr(node);
+    hash.addData((const char *) &ptr, sizeof(quintptr));
+  }
+
+  QByteArray base = hash.result();
+  foreach (Socket *sock, node->sockets()) {
+    if (QNetSocket::RIGHT != sock->side())
+      continue;
+    QCryptographicHash shash(QCryptographicHash::Md5);
+    shash.addData(base);
+    shash.addData(sock->name().toUtf8());
+    quint64 value; memcpy(&value, shash.result().constData(), sizeof(quint64));
+    hashTable.insert(sock, value);
+  }
+}
+
 bool
 Assembler::hasVariable(Socket *sock) const {
-  return _varTable.contains(sock);
+  return _varTable.contains(sock) || _sources.contains(sock);
 }
 
 bool
@@ -184,13 +735,41 @@ Assembler::sourceVar(const NodeBase *node, const QString &name) {
     return stochbb::Var();
   }
 
-  if (! _varTable.contains(sock)) {
+  if (_varTable.contains(sock))
+    return _varTable[sock];
+  if (! _sources.contains(sock)) {
     msgError(_messages) << "Source connected to '" << sock << "' socket of node "
                         << node->label() << " not processed yet!";
     return stochbb::Var();
   }
 
-  return _varTable[sock];
+  return _sources[sock];
+}
+
+bool
+Assembler::addTerm(Socket *sock, const Term &term, const QString &name) {
+  if (! addVariable(sock, term.var(name)))
+    return false;
+  _termTable.insert(sock, term);
+  return true;
+}
+
+Term
+Assembler::sourceTerm(const NodeBase *node, const QString &name) {
+  stochbb::Var var = sourceVar(node, name);
+  if (var.isNull())
+    return Term();
+
+  // The term of the source can only be folded into this node if the node is its only
+  // consumer. Otherwise the variables of both nodes would lose their dependency.
+  Socket *src = _network->findSource(node->socket(name));
+  if (src && (1 == _network->findDestinations(src).size())) {
+    if (_termTable.contains(src))
+      return _termTable[src];
+    if (_sourceTerms.contains(src))
+      return _sourceTerms[src];
+  }
+  return Term(var);
 }
 
 const Messages &
@@ -5,6 +5,7 @@
 #include <QHash>
 #include <QList>
 #include <QSet>
+#include <QPair>
 #include <QTextStream>
 
 #include "nodes.hh"
@@ -47,32 +48,111 @@ protected:
 #define msgError(lst) MessageBuilder(Message::CRITICAL, lst)
 
 
+class Term
+{
+public:
+  Term();
+  Term(const stochbb::Var &var);
+  Term(const Term &other);
+  Term &operator=(const Term &other);
+
+  static Term delta(double value);
+  static Term normal(double mu, double sigma);
+  static Term gamma(double k, double theta);
+  static Term invgamma(double alpha, double beta);
+  static Term weibull(double k, double lambda);
+  static Term uniform(double a, double b);
+
+  bool isNull() const;
+  Term operator+(const Term &other) const;
+  Term affine(double scale, double shift) const;
+  stochbb::Var var(const QString &name) const;
+
+protected:
+  typedef enum {
+    VARIABLE, GAMMA, INVGAMMA, WEIBULL, UNIFORM, SUM
+  } PartType;
+
+  typedef struct {
+    PartType type;
+    double a, b;
+    double scale;
+    stochbb::Var var;
+  } Part;
+
+protected:
+  static Term part(PartType type, double a, double b, const stochbb::Var &var=stochbb::Var());
+  static double width(const Part &part);
+  static int count(const Part &part);
+  static stochbb::Var create(const Part &part);
+  void compact();
+
+protected:
+  bool _null;
+  double _shift;
+  bool _hasNormal;
+  double _mu;
+  double _variance;
+  QList< QPair<double, double> > _gammas;
+  QList<Part> _parts;
+};
+
+
 class Assembler
 {
+public:
+  typedef enum {
+    SERIAL, PARALLEL
+  } Mode;
+
 public:
   bool hasVariable(Socket *sock) const;
   bool addVariable(Socket *sock, const stochbb::Var &var);
   Socket *socket(const NodeBase *node, const QString &name);
   stochbb::Var sourceVar(const NodeBase *node, const QString &name);
+  bool addTerm(Socket *sock, const Term &term, const QString &name);
+  Term sourceTerm(const NodeBase *node, const QString &name);
 
 public:
   static bool assemble(Network *net, QHash<Socket *, stochbb::Var> &varTable);
   static bool assemble(Network *net, QHash<Socket *, stochbb::Var> &varTable, Messages &messages);
+  static bool update(Network *net, QHash<Socket *, stochbb::Var> &varTable,
+                     QHash<Socket *, Term> &termTable, QHash<Socket *, quint64> &hashTable,
+                     QSet<NodeBase *> &invalid, Messages &messages, Mode mode=SERIAL);
 
 protected:
-  typedef QList<NodeBase *> Queue;
+  typedef struct {
+    NodeBase *node;
+    QHash<Socket *, stochbb::Var> variables;
+    QHash<Socket *, Term> terms;
+    Messages messages;
+    bool success;
+  } Job;
 
 protected:
-  Assembler(Network *net, QHash<Socket *, stochbb::Var> &varTable);
+  Assembler(Network *net, QHash<Socket *, stochbb::Var> &varTable,
+            QHash<Socket *, Term> &termTable);
+  Assembler(const Assembler &parent, QHash<Socket *, stochbb::Var> &varTable,
+            QHash<Socket *, Term> &termTable);
+  bool sort(QList<NodeBase *> &order);
   bool assemble();
+  bool assemble(const QSet<NodeBase *> &invalid, Mode mode);
+  bool assemble(NodeBase *node);
+  bool assemble(const QList<NodeBase *> &wavefront);
+  void updateInputs(NodeBase *node);
+  void updateHashes(NodeBase *node, QHash<Socket *, quint64> &hashTable);
 
   const Messages &messages() const;
 
 protected:
   Network *_network;
-  Queue    _queue;
+  QList<NodeBase *> _nodes;
+  QHash<NodeBase *, QList<NodeBase *> > _dependencies;
+  QList<NodeBase *> _cone;
   QHash<Socket *, stochbb::Var> &_varTable;
-  QSet<NodeBase *> _processedNodes;
+  const QHash<Socket *, stochbb::Var> &_sources;
+  QHash<Socket *, Term> &_termTable;
+  const QHash<Socket *, Term> &_sourceTerms;
   Messages _messages;
 };
 
@@ -0,0 +1,95 @@
+#include "csvwriter.hh"
+#include <QVector>
+#include <QLocale>
+#include <QtConcurrent>
+
+
+// Rows formatted by a single job and rows formatted before being written
+static const int csvBlockRows  = 1024;
+static const int csvBufferRows = 64*csvBlockRows;
+
+
+/* ******************************************************************************************** *
+ * Implementation of CSVWriter
+ * ******************************************************************************************** */
+CSVWriter::CSVWriter(char delimiter, int precision)
+  : _delimiter(delimiter), _precision(precision)
+{
+  // pass...
+}
+
+char
+CSVWriter::delimiter() const {
+  return _delimiter;
+}
+
+int
+CSVWriter::precision() const {
+  return _precision;
+}
+
+QByteArray
+CSVWriter::header(const QStringList &names) const {
+  QByteArray line;
+  for (int i=0; i<names.size(); i++) {
+    if (i)
+      line.append(_delimiter);
+    line.append(names[i].toUtf8());
+  }
+  line.append('\n');
+  return line;
+}
+
+QByteArray
+CSVWriter::format(const Eigen::Ref<const Eigen::MatrixXd> &rows) const {
+  // A precision of 0 selects the shortest representation that reads back to the same value
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+  int precision = (_precision > 0) ? _precision : int(QLocale::FloatingPointShortest);
+#else
+  int precision = (_precision > 0) ? _precision : 17;
+#endif
+
+  // Blocks of rows are formatted in parallel and joined in order
+  QVector<QByteArray> blocks((rows.rows()+csvBlockRows-1)/csvBlockRows);
+  QVector<int> index(blocks.size());
+  for (int i=0; i<index.size(); i++)
+    index[i] = i;
+  QtConcurrent::blockingMap(index, [&](int block) {
+    QByteArray &buffer = blocks[block];
+    int end = std::min(int(rows.rows()), (block+1)*csvBlockRows);
+    buffer.reserve((end-block*csvBlockRows)*rows.cols()*24);
+    for (int i=block*csvBlockRows; i<end; i++) {
+      for (int j=0; j<rows.cols(); j++) {
+        if (j)
+          buffer.append(_delimiter);
+        buffer.append(QByteArray::number(rows(i, j), 'g', precision));
+      }
+      buffer.append('\n');
+    }
+  });
+
+  int size = 0;
+  foreach (const QByteArray &buffer, blocks)
+    size += buffer.size();
+  QByteArray text;
+  text.reserve(size);
+  foreach (const QByteArray &buffer, blocks)
+    text.append(buffer);
+  return text;
+}
+
+bool
+CSVWriter::writeHeader(QIODevice &device, const QStringList &names) const {
+  QByteArray line = header(names);
+  return line.size() == device.write(line);
+}
+
+bool
+CSVWriter::write(QIODevice &device, const Eigen::Ref<const Eigen::MatrixXd> &rows) const {
+  for (int i=0; i<rows.rows(); i+=csvBufferRows) {
+    QByteArray text = format(rows.middleRows(i, std::min(csvBufferRows, int(rows.rows())-i)));
+    if (text.size() != device.write(text))
+      return false;
+  }
+  return true;
+}
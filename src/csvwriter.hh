@@ -0,0 +1,29 @@
+#ifndef CSVWRITER_HH
+#define CSVWRITER_HH
+
+#include <QByteArray>
+#include <QStringList>
+#include <QIODevice>
+#include <Eigen/Eigen>
+
+
+class CSVWriter
+{
+public:
+  CSVWriter(char delimiter='\t', int precision=0);
+
+  char delimiter() const;
+  int precision() const;
+
+  QByteArray header(const QStringList &names) const;
+  QByteArray format(const Eigen::Ref<const Eigen::MatrixXd> &rows) const;
+
+  bool writeHeader(QIODevice &device, const QStringList &names) const;
+  bool write(QIODevice &device, const Eigen::Ref<const Eigen::MatrixXd> &rows) const;
+
+protected:
+  char _delimiter;
+  int _precision;
+};
+
+#endif // CSVWRITER_HH
@@ -0,0 +1,162 @@
+#include "densitycache.hh"
+
+
+// QCache counts costs as int, hence grids are accounted for in KiB
+static size_t costUnit = 1024;
+
+const size_t DensityCache::defaultLimit = 64*1024*1024;
+
+
+/* ******************************************************************************************** *
+ * Implementation of DensityCache
+ * ******************************************************************************************** */
+DensityCache::DensityCache(size_t limit)
+  : _mutex(), _cache(limit/costUnit), _hits(0), _misses(0)
+{
+  // pass...
+}
+
+DensityCache &
+DensityCache::instance() {
+  static DensityCache cache;
+  return cache;
+}
+
+size_t
+DensityCache::limit() const {
+  QMutexLocker locker(&_mutex);
+  return size_t(_cache.maxCost())*costUnit;
+}
+
+void
+DensityCache::setLimit(size_t bytes) {
+  QMutexLocker locker(&_mutex);
+  // Evicts the least recently used grids if the cache shrinks
+  _cache.setMaxCost(bytes/costUnit);
+}
+
+size_t
+DensityCache::size() const {
+  QMutexLocker locker(&_mutex);
+  return size_t(_cache.totalCost())*costUnit;
+}
+
+int
+DensityCache::count() const {
+  QMutexLocker locker(&_mutex);
+  return _cache.count();
+}
+
+size_t
+DensityCache::hits() const {
+  QMutexLocker locker(&_mutex);
+  return _hits;
+}
+
+size_t
+DensityCache::misses() const {
+  QMutexLocker locker(&_mutex);
+  return _misses;
+}
+
+void
+DensityCache::clear() {
+  QMutexLocker locker(&_mutex);
+  _cache.clear();
+}
+
+QByteArray
+DensityCache::gridKey(const QByteArray &key, double tmin, double tmax, size_t nstep) {
+  // The key of the upstream network followed by the grid
+  QByteArray grid(key);
+  grid.append((const char *) &tmin, sizeof(double));
+  grid.append((const char *) &tmax, sizeof(double));
+  quint64 n = nstep;
+  grid.append((const char *) &n, sizeof(quint64));
+  return grid;
+}
+
+bool
+DensityCache::lookup(const QByteArray &key, double tmin, double tmax, Eigen::VectorXd &values) {
+  if (key.isEmpty())
+    return false;
+  QMutexLocker locker(&_mutex);
+  // Marks the grid as recently used
+  Eigen::VectorXd *grid = _cache.object(gridKey(key, tmin, tmax, values.size()));
+  if (! grid) {
+    _misses++;
+    return false;
+  }
+  values = *grid;
+  _hits++;
+  return true;
+}
+
+void
+DensityCache::insert(const QByteArray &key, double tmin, double tmax, const Eigen::VectorXd &values) {
+  if (key.isEmpty())
+    return;
+  QMutexLocker locker(&_mutex);
+  int cost = (values.size()*sizeof(double)+costUnit-1)/costUnit;
+  // Grids exceeding the limit are not cached at all
+  _cache.insert(gridKey(key, tmin, tmax, values.size()), new Eigen::VectorXd(values), cost);
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of DensitySet
+ * ******************************************************************************************** */
+DensitySet::DensitySet()
+  : _mutex(), _published(), _grids(), _pending()
+{
+  // pass...
+}
+
+QByteArray
+DensitySet::gridKey(quint64 key, double tmin, double tmax, size_t nstep) {
+  return DensityCache::gridKey(QByteArray((const char *) &key, sizeof(quint64)), tmin, tmax, nstep);
+}
+
+DensitySet::State
+DensitySet::claim(quint64 key, double tmin, double tmax, Eigen::VectorXd &values) {
+  QByteArray grid = gridKey(key, tmin, tmax, values.size());
+  QMutexLocker locker(&_mutex);
+  if (_grids.contains(grid)) {
+    values = _grids[grid];
+    return AVAILABLE;
+  }
+  if (_pending.contains(grid))
+    return PENDING;
+  // The caller evaluates the density and publishes or releases it
+  _pending.insert(grid);
+  return CLAIMED;
+}
+
+void
+DensitySet::publish(quint64 key, double tmin, double tmax, const Eigen::VectorXd &values) {
+  QByteArray grid = gridKey(key, tmin, tmax, values.size());
+  QMutexLocker locker(&_mutex);
+  _grids.insert(grid, values);
+  _pending.remove(grid);
+  _published.wakeAll();
+}
+
+void
+DensitySet::release(quint64 key, double tmin, double tmax, size_t nstep) {
+  QMutexLocker locker(&_mutex);
+  _pending.remove(gridKey(key, tmin, tmax, nstep));
+  _published.wakeAll();
+}
+
+bool
+DensitySet::wait(quint64 key, double tmin, double tmax, Eigen::VectorXd &values) {
+  QByteArray grid = gridKey(key, tmin, tmax, values.size());
+  QMutexLocker locker(&_mutex);
+  while (_pending.contains(grid))
+    _published.wait(&_mutex);
+  // A released claim leaves the evaluation to the waiting caller
+  if (! _grids.contains(grid))
+    return false;
+  values = _grids[grid];
+  return true;
+}
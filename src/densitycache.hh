@@ -0,0 +1,66 @@
+#ifndef DENSITYCACHE_HH
+#define DENSITYCACHE_HH
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <Eigen/Eigen>
+
+
+class DensityCache
+{
+public:
+  DensityCache(size_t limit=defaultLimit);
+
+  size_t limit() const;
+  void setLimit(size_t bytes);
+  size_t size() const;
+  int count() const;
+  size_t hits() const;
+  size_t misses() const;
+  void clear();
+
+  bool lookup(const QByteArray &key, double tmin, double tmax, Eigen::VectorXd &values);
+  void insert(const QByteArray &key, double tmin, double tmax, const Eigen::VectorXd &values);
+
+  static DensityCache &instance();
+  static const size_t defaultLimit;
+  static QByteArray gridKey(const QByteArray &key, double tmin, double tmax, size_t nstep);
+
+protected:
+  mutable QMutex _mutex;
+  QCache<QByteArray, Eigen::VectorXd> _cache;
+  size_t _hits;
+  size_t _misses;
+};
+
+
+class DensitySet
+{
+public:
+  typedef enum {
+    AVAILABLE, CLAIMED, PENDING
+  } State;
+
+public:
+  DensitySet();
+
+  State claim(quint64 key, double tmin, double tmax, Eigen::VectorXd &values);
+  void publish(quint64 key, double tmin, double tmax, const Eigen::VectorXd &values);
+  void release(quint64 key, double tmin, double tmax, size_t nstep);
+  bool wait(quint64 key, double tmin, double tmax, Eigen::VectorXd &values);
+
+protected:
+  static QByteArray gridKey(quint64 key, double tmin, double tmax, size_t nstep);
+
+protected:
+  QMutex _mutex;
+  QWaitCondition _published;
+  QHash<QByteArray, Eigen::VectorXd> _grids;
+  QSet<QByteArray> _pending;
+};
+
+#endif // DENSITYCACHE_HH
@@ -2,12 +2,9 @@
 #define EDGE_HH
 
 #include "qnetview.hh"
-#include <QDomElement>
 
 class Socket;
 class Network;
-class NodeBase;
-class ParserInfo;
 
 
 class Edge : public QNetEdge
@@ -16,11 +13,6 @@ class Edge : public QNetEdge
 
 public:
   explicit Edge(Socket *a, Socket *b, Network *net=0);
-
-  QDomElement serialize(QDomDocument &doc) const;
-
-public:
-  static Edge *fromXml(const QDomElement &node, const QHash<QString, NodeBase *> &node_table, ParserInfo &info);
 };
 
 #endif // EDGE_HH
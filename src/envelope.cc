@@ -0,0 +1,164 @@
+#include "envelope.hh"
+#include <algorithm>
+
+
+/* ******************************************************************************************** *
+ * Implementation of EnvelopePyramid
+ * ******************************************************************************************** */
+EnvelopePyramid::EnvelopePyramid()
+  : _data(), _imin(), _imax()
+{
+  // pass...
+}
+
+EnvelopePyramid::EnvelopePyramid(const PlotData &data)
+  : _data(data), _imin(), _imax()
+{
+  // Level l+1 holds the indices of the minimum and maximum within each bucket of 2^(l+1)
+  // consecutive points, it is obtained by merging pairs of buckets of the level below
+  PlotData::Column y = _data.y();
+  int n = _data.size();
+  Eigen::VectorXi lmin = Eigen::VectorXi::LinSpaced(n, 0, n-1), lmax = lmin;
+  while (lmin.size() > 1) {
+    int m = (lmin.size()+1)/2;
+    Eigen::VectorXi nmin(m), nmax(m);
+    for (int b=0; b<m; b++) {
+      int l = 2*b, r = std::min(2*b+1, int(lmin.size())-1);
+      nmin(b) = (y(lmin(r)) < y(lmin(l))) ? lmin(r) : lmin(l);
+      nmax(b) = (y(lmax(r)) > y(lmax(l))) ? lmax(r) : lmax(l);
+    }
+    _imin.append(nmin); _imax.append(nmax);
+    lmin = nmin; lmax = nmax;
+  }
+}
+
+size_t
+EnvelopePyramid::size() const {
+  return _data.size();
+}
+
+const PlotData &
+EnvelopePyramid::data() const {
+  return _data;
+}
+
+void
+EnvelopePyramid::envelope(double xmin, double xmax, int nbuckets, QCPDataMap &data) const {
+  data.clear();
+  PlotData::Column x = _data.x(), y = _data.y();
+  int n = _data.size();
+  if (0 == n)
+    return;
+
+  // Include one point beyond either edge, hence lines reach the borders of the view
+  int first = std::lower_bound(x.data(), x.data()+n, xmin) - x.data();
+  int last = std::upper_bound(x.data(), x.data()+n, xmax) - x.data();
+  first = std::max(0, first-1); last = std::min(n, last+1);
+  int count = last-first;
+
+  if (count <= 2*nbuckets) {
+    for (int i=first; i<last; i++)
+      data.insert(x(i), QCPData(x(i), y(i)));
+    return;
+  }
+
+  // Pick the finest level with at most nbuckets buckets in view. Each bucket contributes its
+  // minimum and maximum in their original order, hence the envelope matches the full curve.
+  int level = 1;
+  while ((level < _imin.size()) && ((count >> level) > nbuckets))
+    level++;
+  const Eigen::VectorXi &imin = _imin[level-1], &imax = _imax[level-1];
+  for (int b=(first >> level); b<=((last-1) >> level); b++) {
+    data.insert(x(imin(b)), QCPData(x(imin(b)), y(imin(b))));
+    data.insert(x(imax(b)), QCPData(x(imax(b)), y(imax(b))));
+  }
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of EnvelopePlot
+ * ******************************************************************************************** */
+EnvelopePlot::EnvelopePlot(QCustomPlot *plot)
+  : QObject(plot), _plot(plot), _series(), _refined(), _graphs(), _range(), _buckets(0)
+{
+  connect(_plot, SIGNAL(beforeReplot()), this, SLOT(onBeforeReplot()));
+}
+
+int
+EnvelopePlot::count() const {
+  return _series.size();
+}
+
+const EnvelopePyramid &
+EnvelopePlot::series(int i) const {
+  return _series[i];
+}
+
+QCPGraph *
+EnvelopePlot::graph(int i) const {
+  return _graphs[i];
+}
+
+int
+EnvelopePlot::buckets() const {
+  // One bucket, i.e. up to two points, per pixel column
+  return std::max(100, _plot->axisRect()->width());
+}
+
+int
+EnvelopePlot::addSeries(QCPGraph *graph, const PlotData &data) {
+  _series.append(EnvelopePyramid(data));
+  _refined.append(PlotData());
+  _graphs.append(graph);
+  // Initially, show the envelope of the complete series
+  QCPDataMap *visible = new QCPDataMap();
+  if (data.size())
+    _series.last().envelope(data.x()(0), data.x()(data.size()-1), buckets(), *visible);
+  graph->setData(visible, false);
+  return _series.size()-1;
+}
+
+void
+EnvelopePlot::setSeries(int i, const PlotData &data) {
+  // A refinement of the previous series is outdated
+  _series[i] = EnvelopePyramid(data);
+  _refined[i] = PlotData();
+  update(true);
+}
+
+void
+EnvelopePlot::setRefinement(int i, const PlotData &data) {
+  _refined[i] = data;
+  update(true);
+}
+
+void
+EnvelopePlot::update(bool force) {
+  QCPRange range = _plot->xAxis->range();
+  int nbuckets = buckets();
+  if ((! force) && (range == _range) && (nbuckets == _buckets))
+    return;
+  _range = range; _buckets = nbuckets;
+  for (int i=0; i<_series.size(); i++) {
+    QCPDataMap *data = new QCPDataMap();
+    _series[i].envelope(range.lower, range.upper, nbuckets, *data);
+    // The refined points replace the series within their interval
+    const PlotData &refined = _refined[i];
+    if (refined.size()) {
+      PlotData::Column x = refined.x(), y = refined.y();
+      QCPDataMap::iterator item = data->lowerBound(x(0));
+      while ((item != data->end()) && (item.key() <= x(x.size()-1)))
+        item = data->erase(item);
+      for (int j=0; j<x.size(); j++)
+        data->insert(x(j), QCPData(x(j), y(j)));
+    }
+    _graphs[i]->setData(data, false);
+  }
+}
+
+void
+EnvelopePlot::onBeforeReplot() {
+  // Replots follow every zoom, pan and resize. Only the points visible at the current
+  // resolution are handed to the graphs.
+  update();
+}
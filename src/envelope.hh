@@ -0,0 +1,58 @@
+#ifndef ENVELOPE_HH
+#define ENVELOPE_HH
+
+#include <QObject>
+#include <QVector>
+#include <Eigen/Eigen>
+#include "qcustomplot.hh"
+#include "plotdata.hh"
+
+
+class EnvelopePyramid
+{
+public:
+  EnvelopePyramid();
+  EnvelopePyramid(const PlotData &data);
+
+  size_t size() const;
+  const PlotData &data() const;
+  void envelope(double xmin, double xmax, int nbuckets, QCPDataMap &data) const;
+
+protected:
+  PlotData _data;
+  QVector<Eigen::VectorXi> _imin;
+  QVector<Eigen::VectorXi> _imax;
+};
+
+
+class EnvelopePlot: public QObject
+{
+  Q_OBJECT
+
+public:
+  EnvelopePlot(QCustomPlot *plot);
+
+  int count() const;
+  const EnvelopePyramid &series(int i) const;
+  QCPGraph *graph(int i) const;
+  int addSeries(QCPGraph *graph, const PlotData &data);
+  void setSeries(int i, const PlotData &data);
+  void setRefinement(int i, const PlotData &data);
+  int buckets() const;
+
+public slots:
+  void update(bool force=false);
+
+protected slots:
+  void onBeforeReplot();
+
+protected:
+  QCustomPlot *_plot;
+  QVector<EnvelopePyramid> _series;
+  QVector<PlotData> _refined;
+  QVector<QCPGraph *> _graphs;
+  QCPRange _range;
+  int _buckets;
+};
+
+#endif // ENVELOPE_HH
@@ -0,0 +1,258 @@
+#include "kde.hh"
+#include <cmath>
+#include <algorithm>
+#include <QVector>
+#include <QtConcurrent>
+#ifdef WITH_FFTW3
+#include <fftw3.h>
+#include <QMutex>
+#endif
+
+
+// Up to this number of samples, the KDE is evaluated exactly
+static const int kdeExactLimit = 10000;
+// Number of grid points of the binned KDE
+static const int kdeGridSize = 4096;
+// The kernel is truncated at this many bandwidths, the neglected tail is below exp(-32) ~ 1e-14
+// relative to the kernel maximum
+static const double kdeKernelWidth = 8;
+
+#ifdef WITH_FFTW3
+// Only the execution of FFTW plans is thread-safe, their creation is not
+static QMutex fftwPlannerLock;
+#endif
+
+
+// Linear binning of samples onto a grid of kdeGridSize points starting at min
+static void
+binLinear(const Eigen::Ref<const Eigen::VectorXd> &samples, double min, double dx, Eigen::VectorXd &counts) {
+  for (int j=0; j<samples.size(); j++) {
+    double pos = (samples(j)-min)/dx;
+    int i = std::max(0, std::min(int(pos), kdeGridSize-2));
+    double w = pos-i;
+    counts(i) += 1-w;
+    counts(i+1) += w;
+  }
+}
+
+// Silverman's rule of thumb. Constant samples have no spread, their bandwidth is taken from the
+// magnitude of the samples instead, like the padding in KDEBins::reset().
+static double
+ruleOfThumb(double mu, double sigma2, size_t n) {
+  double scale = std::max(1.0, std::abs(mu));
+  double sigma = (sigma2 > 0) ? std::sqrt(sigma2) : 0;
+  if (! (sigma > 1e-8*scale))
+    sigma = scale/2;
+  return 1.06*sigma*std::pow(double(std::max(size_t(1), n)), -0.2);
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of KDEBins
+ * ******************************************************************************************** */
+KDEBins::KDEBins()
+  : _min(0), _max(0), _dx(0), _count(0), _sum(0), _sum2(0), _counts()
+{
+  // pass...
+}
+
+bool
+KDEBins::covers(double min, double max) const {
+  return _count && (min >= _min) && (max <= _max);
+}
+
+void
+KDEBins::reset(double min, double max) {
+  // The grid extends the interval by a quarter to either side, hence it rarely needs to grow while
+  // samples are added
+  double pad = (max > min) ? (max-min)/4 : std::max(1.0, std::abs(min))/2;
+  _min = min-pad; _max = max+pad;
+  _dx = (_max-_min)/(kdeGridSize-1);
+  _count = 0; _sum = _sum2 = 0;
+  _counts.setZero(kdeGridSize);
+}
+
+void
+KDEBins::add(const Eigen::Ref<const Eigen::VectorXd> &samples) {
+  binLinear(samples, _min, _dx, _counts);
+  _count += samples.size();
+  _sum += samples.sum();
+  _sum2 += samples.squaredNorm();
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of KDE
+ * ******************************************************************************************** */
+KDE::KDE(const Eigen::Ref<Eigen::VectorXd> &samples, Mode mode)
+  : _mode(mode), _min(samples.minCoeff()), _max(samples.maxCoeff()), _bw(1),
+    _samples(samples.data(), samples.size()), _sorted(), _dx(0), _grid()
+{
+  double mu = _samples.mean();
+  double sigma2 = (_samples.array()*_samples.array()).mean() - mu*mu;
+  // The range is widened by the bandwidth, hence it is never empty
+  _bw = ruleOfThumb(mu, sigma2, _samples.size());
+  _min -= 3*_bw;
+  _max += 3*_bw;
+
+  if (AUTO == _mode)
+    _mode = (_samples.size() > kdeExactLimit) ? BINNED : EXACT;
+  if (BINNED == _mode) {
+    bin();
+  } else {
+    // Sorted samples allow to restrict the sum to the support of the kernel
+    _sorted = _samples;
+    std::sort(_sorted.data(), _sorted.data()+_sorted.size());
+  }
+}
+
+KDE::KDE(const KDEBins &bins)
+  : _mode(BINNED), _min(bins._min), _max(bins._max), _bw(1), _samples(0, 0), _sorted(),
+    _dx(bins._dx), _grid()
+{
+  // The same rule of thumb as above, from the moments of the binned samples
+  size_t n = std::max(size_t(1), bins._count);
+  double mu = bins._sum/n;
+  double sigma2 = bins._sum2/n - mu*mu;
+  _bw = ruleOfThumb(mu, sigma2, n);
+  convolve(bins._counts, n);
+}
+
+KDE::Mode
+KDE::mode() const {
+  return _mode;
+}
+
+double
+KDE::eval(double x) const {
+  if (BINNED == _mode)
+    return evalBinned(x);
+  return evalExact(x);
+}
+
+void
+KDE::eval(const Eigen::VectorXd &x, Eigen::VectorXd &y) const {
+  y.resize(x.size());
+  if (BINNED == _mode) {
+    for (int i=0; i<x.size(); i++)
+      y(i) = evalBinned(x(i));
+    return;
+  }
+  // Evaluation points are independent, spread them across all cores
+  QVector<int> index(x.size());
+  for (int i=0; i<index.size(); i++)
+    index[i] = i;
+  QtConcurrent::blockingMap(index, [&](int i) {
+    y(i) = evalExact(x(i));
+  });
+}
+
+double
+KDE::evalExact(double x) const {
+  // Only samples within the support of the truncated kernel contribute
+  const double *begin = std::lower_bound(_sorted.data(), _sorted.data()+_sorted.size(),
+                                         x-kdeKernelWidth*_bw);
+  const double *end = std::upper_bound(begin, _sorted.data()+_sorted.size(),
+                                       x+kdeKernelWidth*_bw);
+  if (begin == end)
+    return 0;
+  // Eigen evaluates exp() on SIMD packets
+  Eigen::Map<const Eigen::ArrayXd> d(begin, end-begin);
+  double res = (-0.5*((d-x)/_bw).square()).exp().sum();
+  return res / (std::sqrt(2*M_PI)*_samples.size()*_bw);
+}
+
+double
+KDE::evalBinned(double x) const {
+  // Linear interpolation between the grid points
+  double pos = (x-_min)/_dx;
+  if ((pos < 0) || (pos > kdeGridSize-1))
+    return 0;
+  int i = std::min(int(pos), kdeGridSize-2);
+  double w = pos-i;
+  return (1-w)*_grid(i) + w*_grid(i+1);
+}
+
+void
+KDE::bin() {
+  // Distribute each sample linearly onto its two neighbouring grid points
+  _dx = (_max-_min)/(kdeGridSize-1);
+  Eigen::VectorXd counts = Eigen::VectorXd::Zero(kdeGridSize);
+  binLinear(_samples, _min, _dx, counts);
+  convolve(counts, _samples.size());
+}
+
+void
+KDE::convolve(const Eigen::VectorXd &counts, size_t n) {
+  // Gaussian kernel on the grid, truncated and normalized like the exact estimator
+  int L = std::min(kdeGridSize-1, int(std::ceil(kdeKernelWidth*_bw/_dx)));
+  Eigen::VectorXd kernel(L+1);
+  for (int j=0; j<=L; j++)
+    kernel(j) = std::exp(-0.5*(j*_dx/_bw)*(j*_dx/_bw)) / (std::sqrt(2*M_PI)*n*_bw);
+
+  _grid.resize(kdeGridSize);
+#ifdef WITH_FFTW3
+  // Circular convolution of the zero-padded counts, the padding avoids wrap-around
+  int P = 1; while (P < kdeGridSize+L) P *= 2;
+  double *in = fftw_alloc_real(P);
+  fftw_complex *counts_f = fftw_alloc_complex(P/2+1);
+  fftw_complex *kernel_f = fftw_alloc_complex(P/2+1);
+  fftw_plan forward, backward;
+  {
+    QMutexLocker lock(&fftwPlannerLock);
+    forward = fftw_plan_dft_r2c_1d(P, in, counts_f, FFTW_ESTIMATE);
+    backward = fftw_plan_dft_c2r_1d(P, counts_f, in, FFTW_ESTIMATE);
+  }
+
+  std::fill(in, in+P, 0.0);
+  for (int j=0; j<=L; j++) {
+    in[j] = kernel(j);
+    if (j)
+      in[P-j] = kernel(j);
+  }
+  fftw_execute_dft_r2c(forward, in, kernel_f);
+
+  std::fill(in, in+P, 0.0);
+  std::copy(counts.data(), counts.data()+kdeGridSize, in);
+  fftw_execute_dft_r2c(forward, in, counts_f);
+
+  for (int j=0; j<(P/2+1); j++) {
+    double re = counts_f[j][0]*kernel_f[j][0] - counts_f[j][1]*kernel_f[j][1];
+    double im = counts_f[j][0]*kernel_f[j][1] + counts_f[j][1]*kernel_f[j][0];
+    counts_f[j][0] = re/P; counts_f[j][1] = im/P;
+  }
+  fftw_execute_dft_c2r(backward, counts_f, in);
+  for (int i=0; i<kdeGridSize; i++)
+    _grid(i) = std::max(0.0, in[i]);
+
+  {
+    QMutexLocker lock(&fftwPlannerLock);
+    fftw_destroy_plan(forward);
+    fftw_destroy_plan(backward);
+  }
+  fftw_free(in); fftw_free(counts_f); fftw_free(kernel_f);
+#else
+  // Direct convolution with the truncated kernel
+  for (int i=0; i<kdeGridSize; i++) {
+    double res = 0;
+    for (int j=std::max(0, i-L); j<=std::min(kdeGridSize-1, i+L); j++)
+      res += counts(j)*kernel(std::abs(i-j));
+    _grid(i) = res;
+  }
+#endif
+}
+
+double
+KDE::min() const {
+  return _min;
+}
+
+double
+KDE::max() const {
+  return _max;
+}
+
+double
+KDE::bandwidth() const {
+  return _bw;
+}
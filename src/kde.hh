@@ -0,0 +1,59 @@
+#ifndef KDE_HH
+#define KDE_HH
+
+#include <Eigen/Eigen>
+
+
+class KDEBins
+{
+public:
+  KDEBins();
+
+  bool covers(double min, double max) const;
+  void reset(double min, double max);
+  void add(const Eigen::Ref<const Eigen::VectorXd> &samples);
+
+protected:
+  double _min, _max, _dx;
+  size_t _count;
+  double _sum, _sum2;
+  Eigen::VectorXd _counts;
+
+  friend class KDE;
+};
+
+
+class KDE
+{
+public:
+  typedef enum {
+    AUTO, EXACT, BINNED
+  } Mode;
+
+public:
+  explicit KDE(const Eigen::Ref<Eigen::VectorXd> &samples, Mode mode=AUTO);
+  explicit KDE(const KDEBins &bins);
+
+  Mode mode() const;
+  double eval(double x) const;
+  void eval(const Eigen::VectorXd &x, Eigen::VectorXd &y) const;
+  double min() const;
+  double max() const;
+  double bandwidth() const;
+
+protected:
+  double evalExact(double x) const;
+  double evalBinned(double x) const;
+  void bin();
+  void convolve(const Eigen::VectorXd &counts, size_t n);
+
+protected:
+  Mode _mode;
+  double _min, _max, _bw;
+  Eigen::Map<const Eigen::VectorXd> _samples;
+  Eigen::VectorXd _sorted;
+  double _dx;
+  Eigen::VectorXd _grid;
+};
+
+#endif // KDE_HH
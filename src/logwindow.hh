@@ -26,7 +26,7 @@ class LogWindow: public QListWidget
 public:
   LogWindow(QWidget *parent=0);
 
-protected slots:
+public slots:
   void onMessage(QString msg);
 };
 
@@ -3,11 +3,16 @@
 #include "network.hh"
 #include "nodes.hh"
 #include "assembler.hh"
+#include "runwidget.hh"
+#include "plotwindow.hh"
+#include "samplecache.hh"
+#include "densitycache.hh"
 
 #include <QTabWidget>
 #include <QMenuBar>
 #include <QMenu>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QToolBar>
 #include <QToolButton>
 #include <QMessageBox>
@@ -20,6 +25,7 @@
 #include <QSvgGenerator>
 #include <QPrinter>
 #include <QDebug>
+#include <QThread>
 #include <QApplication>
 
 
@@ -36,6 +42,10 @@ MainWindow::MainWindow(QWidget *parent)
   _log = new LogWindow(this);
   _log->setVisible(false);
 
+  _run = new RunWidget(this);
+  connect(_run, SIGNAL(finished()), this, SLOT(onRunFinished()));
+  DensityCache::instance().setLimit(size_t(_settings.value("density/cache", 64).toInt())*1024*1024);
+
   _netedit = new NetEditWidget();
   connect(_netedit->network(), SIGNAL(modified()), this, SLOT(updateTitle()));
   updateTitle();
@@ -43,6 +53,7 @@ MainWindow::MainWindow(QWidget *parent)
   QWidget *panel = new QWidget();
   QVBoxLayout *layout = new QVBoxLayout();
   layout->addWidget(_netedit, 1);
+  layout->addWidget(_run, 0);
   layout->addWidget(_log, 0);
   layout->setMargin(0);
   layout->setSpacing(0);
@@ -65,10 +76,26 @@ MainWindow::MainWindow(QWidget *parent)
   file_menu->addSeparator();
   file_menu->addAction(tr("Export network ..."), this, SLOT(onImageExport()));
   file_menu->addSeparator();
-  QAction *check_action = file_menu->addAction(
+  _checkAction = file_menu->addAction(
         QIcon("://icons/check_64.png"), tr("Verify"), this, SLOT(onCheck()));
-  QAction *run_action = file_menu->addAction(
+  _runAction = file_menu->addAction(
         QIcon("://icons/play_64.png"), tr("Run"), this, SLOT(onRun()));
+  QAction *parallel_action = file_menu->addAction(tr("Parallel assembly"));
+  parallel_action->setCheckable(true);
+  parallel_action->setChecked(_settings.value("assembler/parallel", false).toBool());
+  onParallelAssembly(parallel_action->isChecked());
+  connect(parallel_action, SIGNAL(toggled(bool)), this, SLOT(onParallelAssembly(bool)));
+  QAction *sampling_action = file_menu->addAction(tr("Parallel sampling"));
+  sampling_action->setCheckable(true);
+  sampling_action->setChecked(_settings.value("sampler/parallel", false).toBool());
+  connect(sampling_action, SIGNAL(toggled(bool)), this, SLOT(onParallelSampling(bool)));
+  QAction *cache_action = file_menu->addAction(tr("Cache samples"));
+  cache_action->setCheckable(true);
+  cache_action->setChecked(_settings.value("sampler/cache", false).toBool());
+  cache_action->setToolTip(tr("Reuse samples of earlier runs of the same network. The seed is not "
+                              "part of the cache key, hence cached runs replay the same realisations."));
+  connect(cache_action, SIGNAL(toggled(bool)), this, SLOT(onCacheSamples(bool)));
+  file_menu->addAction(tr("Density cache size ..."), this, SLOT(onDensityCacheLimit()));
   file_menu->addSeparator();
   QAction *quit = file_menu->addAction(tr("Quit"), this, SLOT(onQuit()));
   quit->setShortcut(Qt::CTRL + Qt::Key_Q);
@@ -130,8 +157,8 @@ MainWindow::MainWindow(QWidget *parent)
 
   QToolBar *toolbar = new QToolBar();
   toolbar->setToolButtonStyle(Qt::ToolButtonIconOnly);
-  toolbar->addAction(check_action);
-  toolbar->addAction(run_action);
+  toolbar->addAction(_checkAction);
+  toolbar->addAction(_runAction);
 
   toolbar->addSeparator();
   QToolButton* add_rand = new QToolButton();
@@ -347,9 +374,12 @@ MainWindow::onImageExport() {
 
 void
 MainWindow::onCheck() {
-  QHash<Socket *, stochbb::Var> varTable;
+  // Running tasks hold variables of the network, re-assembling it would replace them
+  if (_run->isRunning())
+    return;
+
   Messages messages;
-  if (! Assembler::assemble(_netedit->network(), varTable, messages)) {
+  if (! _netedit->network()->assemble(messages)) {
     QStringList tmp;
     foreach (Message msg, messages) {
       tmp.append(msg.text());
@@ -362,21 +392,81 @@ MainWindow::onCheck() {
 
 void
 MainWindow::onRun() {
-  QHash<Socket *, stochbb::Var> varTable;
-  if (! Assembler::assemble(_netedit->network(), varTable)) {
+  if (_run->isRunning()) {
+    QMessageBox::information(
+          0, tr("Can not run network."),
+          tr("The network is still running. Wait for it to finish or cancel it."));
+    return;
+  }
+
+  Messages messages;
+  if (! _netedit->network()->assemble(messages)) {
     QMessageBox::critical(
           0, tr("Can not run network."),
           tr("There was an error during the analysis step: Run 'Check Network'."));
     return;
   }
-
-  // Collect output nodes from network
+  const QHash<Socket *, stochbb::Var> &varTable = _netedit->network()->variables();
+
+  // Collect output nodes from network, their results are computed in the background. All
+  // sample-based outputs share a single sampling pass.
+  QSharedPointer<SampleSet> samples(new SampleSet());
+  if (_settings.value("sampler/parallel", false).toBool())
+    samples->setThreads(QThread::idealThreadCount());
+  QList<OutputTask *> tasks;
   Network::nodeIterator node = _netedit->network()->nodesBegin();
   for (; node != _netedit->network()->nodesEnd(); node++) {
     if (OutputNode *out = dynamic_cast<OutputNode *>(*node)) {
-      out->execute(varTable);
+      if (OutputTask *task = out->createTask(varTable, samples))
+        tasks.append(task);
     }
   }
+  if (_settings.value("sampler/cache", false).toBool())
+    samples->setCache(_netedit->network()->samplingKey(samples->sources()),
+                      SampleCache::defaultDirectory());
+  _run->start(tasks);
+  // The network must not be re-assembled until all tasks are done
+  _checkAction->setEnabled(! _run->isRunning());
+  _runAction->setEnabled(! _run->isRunning());
+}
+
+void
+MainWindow::onParallelAssembly(bool enabled) {
+  _settings.setValue("assembler/parallel", enabled);
+  _netedit->network()->setAssemblyMode(enabled ? Assembler::PARALLEL : Assembler::SERIAL);
+}
+
+void
+MainWindow::onParallelSampling(bool enabled) {
+  _settings.setValue("sampler/parallel", enabled);
+}
+
+void
+MainWindow::onCacheSamples(bool enabled) {
+  _settings.setValue("sampler/cache", enabled);
+}
+
+void
+MainWindow::onDensityCacheLimit() {
+  bool ok;
+  int limit = QInputDialog::getInt(this, tr("Density cache size"),
+                                   tr("Memory for evaluated densities in MiB (0 disables the cache):"),
+                                   _settings.value("density/cache", 64).toInt(), 0, 1024*1024, 1, &ok);
+  if (! ok)
+    return;
+  _settings.setValue("density/cache", limit);
+  DensityCache::instance().setLimit(size_t(limit)*1024*1024);
+  onRunFinished();
+}
+
+void
+MainWindow::onRunFinished() {
+  _checkAction->setEnabled(true);
+  _runAction->setEnabled(true);
+  DensityCache &cache = DensityCache::instance();
+  _log->onMessage(tr("INFO Density cache: %1 grids, %2 of %3 MiB used, %4 hits, %5 misses.")
+                  .arg(cache.count()).arg(double(cache.size())/(1024*1024), 0, 'f', 1)
+                  .arg(cache.limit()/(1024*1024)).arg(cache.hits()).arg(cache.misses()));
 }
 
 void
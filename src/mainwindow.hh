@@ -8,6 +8,7 @@
 
 
 class NetEditWidget;
+class RunWidget;
 
 
 class MainWindow : public QMainWindow
@@ -26,6 +27,11 @@ protected slots:
   void onLoad(QAction *action);
   void onCheck();
   void onRun();
+  void onParallelAssembly(bool enabled);
+  void onParallelSampling(bool enabled);
+  void onCacheSamples(bool enabled);
+  void onDensityCacheLimit();
+  void onRunFinished();
   void onHelp();
   void onAbout();
   void updateTitle();
@@ -39,6 +45,9 @@ protected:
 protected:
   NetEditWidget *_netedit;
   LogWindow *_log;
+  RunWidget *_run;
+  QAction *_checkAction;
+  QAction *_runAction;
   QMenu *_recent;
   QSettings _settings;
   QTranslator _translator;
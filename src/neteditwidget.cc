@@ -196,6 +196,8 @@ NetEditWidget::zoomOut() {
 void
 NetEditWidget::onEditNodeConfig(QNetNode *node) {
   NodeBase *n = dynamic_cast<NodeBase *>(node);
-  if (n && (QDialog::Accepted == NodeConfigDialog(n).exec()))
+  if (n && (QDialog::Accepted == NodeConfigDialog(n).exec())) {
+    _netview->invalidate(n);
     _netview->setModified(true);
+  }
 }
@@ -0,0 +1,315 @@
+#include "netmodel.hh"
+#include <QFile>
+#include <QUrl>
+#include <QStringList>
+#include <QTextStream>
+#include <QXmlSchema>
+#include <QXmlSchemaValidator>
+#include <QSourceLocation>
+
+
+/* ******************************************************************************************** *
+ * Implementation of SchemaMessageHandler
+ * ******************************************************************************************** */
+SchemaMessageHandler::SchemaMessageHandler(ParserInfo &info, QObject *parent)
+  : QAbstractMessageHandler(parent), _info(info)
+{
+  // pass...
+}
+
+void
+SchemaMessageHandler::handleMessage(QtMsgType type, const QString &description,
+                                    const QUrl &identifier, const QSourceLocation &sourceLocation)
+{
+  ParserInfo::State state = ParserInfo::ERROR;
+  if (QtWarningMsg == type)
+    state = ParserInfo::WARNING;
+  else if (QtFatalMsg == type)
+    state = ParserInfo::ERROR;
+  QString text; QTextStream msg(&text);
+  QString desc = description; desc.remove(QRegExp("<[^>]*>"));
+  msg << "@ line " << sourceLocation.line() << ": " << desc;
+  _info.addMessage(state, text);
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of NetModel
+ * ******************************************************************************************** */
+// The model is the load and save representation of a network only. Sockets and assembly are
+// still provided by the node widgets, hence Network::setModel() instantiates the view for both
+// the editor and headless runs.
+NetModel::NetModel()
+  : _nodes(), _sockets(), _edges(), _parameters(), _nodeIndex(), _socketIndex()
+{
+  // pass...
+}
+
+void
+NetModel::clear() {
+  _nodes.clear();
+  _sockets.clear();
+  _edges.clear();
+  _parameters.clear();
+  _nodeIndex.clear();
+  _socketIndex.clear();
+}
+
+int
+NetModel::numNodes() const {
+  return _nodes.size();
+}
+
+const NetModel::Node &
+NetModel::node(int node) const {
+  return _nodes[node];
+}
+
+int
+NetModel::findNode(const QString &id) const {
+  return _nodeIndex.value(id, -1);
+}
+
+int
+NetModel::addNode(const Node &node, const QList<Param> &params) {
+  // The parameters of a node are stored consecutively
+  Node obj(node);
+  obj.firstParameter = _parameters.size();
+  obj.numParameters = params.size();
+  foreach (const Param &param, params)
+    _parameters.append(param);
+  _nodes.append(obj);
+  _nodeIndex.insert(obj.id, _nodes.size()-1);
+  return _nodes.size()-1;
+}
+
+int
+NetModel::addNode(const QDomElement &node, ParserInfo &info) {
+  // Check if node has 'type' attribute
+  if (! node.hasAttribute("type")) {
+    QString text; QTextStream msg(&text);
+    msg << "@line " << node.lineNumber() << ": Node " << node.tagName()
+        << " has no 'type' attribute.";
+    info.addError(text);
+    return -1;
+  }
+
+  Node obj;
+  obj.id = node.attribute("id");
+  obj.type = node.attribute("type");
+  obj.label = node.attribute("label");
+  obj.sibling = node.attribute("sibling");
+  obj.line = node.lineNumber();
+  if (node.hasAttribute("x"))
+    obj.position.setX(node.attribute("x").toInt());
+  else {
+    QString text; QTextStream msg(&text);
+    msg << "@line " << node.lineNumber() << ": Node has no 'x' attribute.";
+    info.addWarning(text);
+  }
+  if (node.hasAttribute("y"))
+    obj.position.setY(node.attribute("y").toInt());
+  else {
+    QString text; QTextStream msg(&text);
+    msg << "@line " << node.lineNumber() << ": Node has no 'y' attribute.";
+    info.addWarning(text);
+  }
+  QDomElement descr = node.firstChildElement("description");
+  if (descr.isElement())
+    obj.description = descr.text();
+
+  QList<Param> params;
+  QDomElement param = node.firstChildElement("parameter");
+  for (; ! param.isNull(); param = param.nextSiblingElement("parameter")) {
+    if (! param.hasAttribute("name")) {
+      QString text; QTextStream msg(&text);
+      msg << "@line " << node.lineNumber() << ": 'parameter' element has no name.";
+      info.addWarning(text);
+      continue;
+    }
+    Param p;
+    p.name = param.attribute("name");
+    p.value = Parameter::fromXml(param, info);
+    params.append(p);
+  }
+
+  return addNode(obj, params);
+}
+
+const NetModel::Param &
+NetModel::parameter(int node, int i) const {
+  return _parameters[_nodes[node].firstParameter + i];
+}
+
+int
+NetModel::numSockets() const {
+  return _sockets.size();
+}
+
+const NetModel::Socket &
+NetModel::socket(int socket) const {
+  return _sockets[socket];
+}
+
+int
+NetModel::findSocket(int node, const QString &name) const {
+  return _socketIndex.value(QPair<int, QString>(node, name), -1);
+}
+
+int
+NetModel::addSocket(int node, const QString &name) {
+  int idx = findSocket(node, name);
+  if (0 <= idx)
+    return idx;
+  Socket sock;
+  sock.node = node;
+  sock.name = name;
+  _sockets.append(sock);
+  _socketIndex.insert(QPair<int, QString>(node, name), _sockets.size()-1);
+  return _sockets.size()-1;
+}
+
+int
+NetModel::numEdges() const {
+  return _edges.size();
+}
+
+const NetModel::Edge &
+NetModel::edge(int edge) const {
+  return _edges[edge];
+}
+
+int
+NetModel::addEdge(int src, int dest, int line) {
+  Edge edge;
+  edge.src = src;
+  edge.dest = dest;
+  edge.line = line;
+  _edges.append(edge);
+  return _edges.size()-1;
+}
+
+int
+NetModel::addEdge(const QDomElement &edge, ParserInfo &info) {
+  QStringList attributes;
+  attributes << "srcNode" << "srcSocket" << "destNode" << "destSocket";
+  foreach (QString attr, attributes) {
+    if (! edge.hasAttribute(attr)) {
+      QString text; QTextStream msg(&text);
+      msg << "@line " << edge.lineNumber() << ": Edge has no '" << attr << "' attribute.";
+      info.addError(text);
+      return -1;
+    }
+  }
+
+  int srcNode = findNode(edge.attribute("srcNode"));
+  if (0 > srcNode) {
+    QString text; QTextStream msg(&text);
+    msg << "@line " << edge.lineNumber() << ": Unknown source node "
+        << edge.attribute("srcNode") << ".";
+    info.addError(text);
+    return -1;
+  }
+  int destNode = findNode(edge.attribute("destNode"));
+  if (0 > destNode) {
+    QString text; QTextStream msg(&text);
+    msg << "@line " << edge.lineNumber() << ": Unknown destination node "
+        << edge.attribute("destNode") << ".";
+    info.addError(text);
+    return -1;
+  }
+
+  return addEdge(addSocket(srcNode, edge.attribute("srcSocket")),
+                 addSocket(destNode, edge.attribute("destSocket")), edge.lineNumber());
+}
+
+bool
+NetModel::load(const QDomDocument &doc, ParserInfo &info) {
+  clear();
+
+  QDomElement root = doc.documentElement();
+
+  // Get schema URL
+  QUrl schemaURL = QUrl("https://hmatuschek.github.io/stochbb/schema/network-1.0");
+  // First, check if Schema is known
+  QFile schemaFile("://xml/network-1.0.xml");
+  if (! schemaFile.open(QIODevice::ReadOnly)) {
+    QString text; QTextStream msg(&text);
+    msg << "Cannot open XML Schema file " << schemaFile.fileName() << ".";
+    info.addError(text); return false;
+  }
+
+  // Get schema
+  QXmlSchema schema;
+  schema.load(&schemaFile, schemaURL);
+  if (! schema.isValid()) {
+    QString text; QTextStream msg(&text);
+    msg << "Invalaid XML Schema " << schemaFile.fileName() << ".";
+    info.addError(text); return false;
+  }
+
+  // Validate document
+  QXmlSchemaValidator validator(schema);
+  SchemaMessageHandler msgHandler(info);
+  validator.setMessageHandler(&msgHandler);
+  if (! validator.validate(doc.toByteArray())) {
+    QString text; QTextStream msg(&text);
+    msg << "Validation failed.";
+    info.addError(text); return false;
+  }
+
+  // Iterate over all "node" children
+  QDomElement node = root.firstChildElement("node");
+  for (; ! node.isNull(); node = node.nextSiblingElement("node")) {
+    if (0 > addNode(node, info))
+      return false;
+  }
+
+  // Iterate over all "edge" children
+  QDomElement edge = root.firstChildElement("edge");
+  for (; ! edge.isNull(); edge = edge.nextSiblingElement("edge")) {
+    if (0 > addEdge(edge, info))
+      return false;
+  }
+
+  return true;
+}
+
+QDomDocument
+NetModel::serialize() const {
+  QDomDocument doc;
+  QDomElement root = doc.createElement("net");
+  for (int i=0; i<_nodes.size(); i++) {
+    const Node &obj = _nodes[i];
+    QDomElement node = doc.createElement("node");
+    node.setAttribute("id", obj.id);
+    node.setAttribute("x", obj.position.x());
+    node.setAttribute("y", obj.position.y());
+    node.setAttribute("label", obj.label);
+    node.setAttribute("type", obj.type);
+    if (! obj.sibling.isEmpty())
+      node.setAttribute("sibling", obj.sibling);
+    for (int j=0; j<obj.numParameters; j++) {
+      QDomElement pnode = parameter(i, j).value.serialize(doc);
+      pnode.setAttribute("name", parameter(i, j).name);
+      node.appendChild(pnode);
+    }
+    if (! obj.description.isEmpty()) {
+      QDomElement descr = doc.createElement("description");
+      descr.appendChild(doc.createTextNode(obj.description));
+      node.appendChild(descr);
+    }
+    root.appendChild(node);
+  }
+  for (int i=0; i<_edges.size(); i++) {
+    const Socket &src = _sockets[_edges[i].src], &dest = _sockets[_edges[i].dest];
+    QDomElement edge = doc.createElement("edge");
+    edge.setAttribute("srcNode", _nodes[src.node].id);
+    edge.setAttribute("srcSocket", src.name);
+    edge.setAttribute("destNode", _nodes[dest.node].id);
+    edge.setAttribute("destSocket", dest.name);
+    root.appendChild(edge);
+  }
+  doc.appendChild(root);
+  return doc;
+}
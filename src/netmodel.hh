@@ -0,0 +1,98 @@
+#ifndef NETMODEL_HH
+#define NETMODEL_HH
+
+#include <QString>
+#include <QPoint>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QAbstractMessageHandler>
+#include "parameter.hh"
+
+
+class SchemaMessageHandler: public QAbstractMessageHandler
+{
+  Q_OBJECT
+
+public:
+  SchemaMessageHandler(ParserInfo &info, QObject *parent=0);
+
+protected:
+  void handleMessage(QtMsgType type, const QString &description,
+                     const QUrl &identifier, const QSourceLocation &sourceLocation);
+
+protected:
+  ParserInfo &_info;
+};
+
+
+
+class NetModel
+{
+public:
+  typedef struct {
+    QString id;
+    QString type;
+    QString label;
+    QString description;
+    QPoint position;
+    QString sibling;
+    int line;
+    int firstParameter;
+    int numParameters;
+  } Node;
+
+  typedef struct {
+    int node;
+    QString name;
+  } Socket;
+
+  typedef struct {
+    int src;
+    int dest;
+    int line;
+  } Edge;
+
+  typedef struct {
+    QString name;
+    Parameter value;
+  } Param;
+
+public:
+  NetModel();
+
+  void clear();
+
+  int numNodes() const;
+  const Node &node(int node) const;
+  int findNode(const QString &id) const;
+  int addNode(const Node &node, const QList<Param> &params);
+  int addNode(const QDomElement &node, ParserInfo &info);
+  const Param &parameter(int node, int i) const;
+
+  int numSockets() const;
+  const Socket &socket(int socket) const;
+  int findSocket(int node, const QString &name) const;
+  int addSocket(int node, const QString &name);
+
+  int numEdges() const;
+  const Edge &edge(int edge) const;
+  int addEdge(int src, int dest, int line=0);
+  int addEdge(const QDomElement &edge, ParserInfo &info);
+
+  bool load(const QDomDocument &doc, ParserInfo &info);
+  QDomDocument serialize() const;
+
+protected:
+  QVector<Node> _nodes;
+  QVector<Socket> _sockets;
+  QVector<Edge> _edges;
+  QVector<Param> _parameters;
+  QHash<QString, int> _nodeIndex;
+  QHash<QPair<int, QString>, int> _socketIndex;
+};
+
+#endif // NETMODEL_HH
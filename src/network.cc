@@ -7,41 +7,16 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
-#include <QXmlSchema>
-#include <QXmlSchemaValidator>
+#include <QStringList>
+#include <QSet>
 #include <QDebug>
 
 
-/* ******************************************************************************************** *
- * Implementation of SchemaMessageHandler
- * ******************************************************************************************** */
-SchemaMessageHandler::SchemaMessageHandler(ParserInfo &info, QObject *parent)
-  : QAbstractMessageHandler(parent), _info(info)
-{
-  // pass...
-}
-
-void
-SchemaMessageHandler::handleMessage(QtMsgType type, const QString &description,
-                                    const QUrl &identifier, const QSourceLocation &sourceLocation)
-{
-  ParserInfo::State state = ParserInfo::ERROR;
-  if (QtWarningMsg == type)
-    state = ParserInfo::WARNING;
-  else if (QtFatalMsg == type)
-    state = ParserInfo::ERROR;
-  QString text; QTextStream msg(&text);
-  QString desc = description; desc.remove(QRegExp("<[^>]*>"));
-  msg << "@ line " << sourceLocation.line() << ": " << desc;
-  _info.addMessage(state, text);
-}
-
-
 /* ******************************************************************************************** *
  * Implementation of Network
  * ******************************************************************************************** */
 Network::Network(QWidget *parent)
-  : QNetView(parent)
+  : QNetView(parent), _assemblyMode(Assembler::SERIAL)
 {
   // pass...
 }
@@ -56,10 +31,8 @@ Network::canConnect(QNetSocket *a, QNetSocket *b) {
     return false;
 
   // Check if input is not used yet
-  foreach (QNetEdge *edge, _edges) {
-    if (edge->dest() == b)
-      return false;
-  }
+  if (hasSource(b))
+    return false;
 
   return dynamic_cast<Socket *>(a) && dynamic_cast<Socket *>(b);
 }
@@ -69,6 +42,50 @@ Network::addConnection(QNetSocket *a, QNetSocket *b) {
   addEdge(new Edge(dynamic_cast<Socket *>(a), dynamic_cast<Socket *>(b)));
 }
 
+void
+Network::addEdge(QNetEdge *edge) {
+  // Terms of a source get only folded into its consumer if there is a single one,
+  // hence changing the number of consumers invalidates all of them.
+  QNetView::addEdge(edge);
+  invalidateDestinations(edge->src());
+}
+
+void
+Network::remEdge(QNetEdge *edge) {
+  invalidateDestinations(edge->src());
+  QNetView::remEdge(edge);
+}
+
+void
+Network::invalidateDestinations(QNetSocket *src) {
+  foreach (QNetSocket *dest, findDestinations(src)) {
+    if (NodeBase *node = dynamic_cast<NodeBase *>(dest->parent()))
+      invalidate(node);
+  }
+}
+
+void
+Network::addNode(QNetNode *node) {
+  QNetView::addNode(node);
+  if (NodeBase *obj = dynamic_cast<NodeBase *>(node))
+    invalidate(obj);
+}
+
+void
+Network::remNode(QNetNode *node) {
+  // Forget the variables of the node, removing the node also removes its edges
+  // which invalidates all nodes connected to its outputs.
+  QNetView::remNode(node);
+  if (NodeBase *obj = dynamic_cast<NodeBase *>(node)) {
+    foreach (Socket *sock, obj->sockets()) {
+      _varTable.remove(sock);
+      _termTable.remove(sock);
+      _hashTable.remove(sock);
+    }
+    _invalid.remove(obj);
+  }
+}
+
 Socket *
 Network::findSource(Socket *dest) {
   QList<QNetSocket *> srcs = this->findSources(dest);
@@ -92,6 +109,114 @@ void
 Network::clear() {
   _filepath.clear();
   QNetView::clear();
+  _varTable.clear();
+  _termTable.clear();
+  _hashTable.clear();
+  _invalid.clear();
+}
+
+void
+Network::invalidate(NodeBase *node) {
+  _invalid.insert(node);
+}
+
+Assembler::Mode
+Network::assemblyMode() const {
+  return _assemblyMode;
+}
+
+void
+Network::setAssemblyMode(Assembler::Mode mode) {
+  _assemblyMode = mode;
+}
+
+bool
+Network::assemble(Messages &messages) {
+  // Re-assembles only the invalidated nodes and those depending on them
+  return Assembler::update(this, _varTable, _termTable, _hashTable, _invalid, messages, _assemblyMode);
+}
+
+const QHash<Socket *, stochbb::Var> &
+Network::variables() const {
+  return _varTable;
+}
+
+quint64
+Network::structuralHash(Socket *socket) {
+  // Inputs share the hash of their source
+  if (QNetSocket::LEFT == socket->side())
+    socket = findSource(socket);
+  return _hashTable.value(socket, 0);
+}
+
+QByteArray
+Network::samplingKey(const QVector<Socket *> &sources) {
+  // Nodes are numbered in the order they are reached from the sources. Hence the key describes
+  // the upstream network including which sources share ancestors, but not the identity of the
+  // nodes, and it stays the same if the network is saved and loaded again. The seed of the
+  // random number generator is not part of the key, hence a cached run replays the realisations
+  // of the run that filled the cache.
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  QHash<NodeBase *, int> index;
+  foreach (Socket *source, sources) {
+    NodeBase *node = source ? dynamic_cast<NodeBase *>(source->parent()) : 0;
+    if (! node)
+      return QByteArray();
+    hash.addData(QByteArray::number(addSamplingKey(node, index, hash)));
+    hash.addData(source->name().toUtf8());
+  }
+  return hash.result();
+}
+
+int
+Network::addSamplingKey(NodeBase *root, QHash<NodeBase *, int> &index, QCryptographicHash &hash) {
+  // Post-order traversal with an explicit stack, long chains would overflow the call stack.
+  // The sources of a node are pushed in reverse, hence they get numbered in the order of the
+  // inputs. A node is numbered and hashed once all of its sources are.
+  QList<NodeBase *> stack;
+  QSet<NodeBase *> expanded;
+  stack.append(root);
+  while (stack.size()) {
+    NodeBase *node = stack.last();
+    if (index.contains(node)) {
+      stack.removeLast();
+      continue;
+    }
+    if (! expanded.contains(node)) {
+      expanded.insert(node);
+      QList<Socket *> inputs = node->inputs();
+      for (int i=inputs.size()-1; i>=0; i--) {
+        Socket *source = findSource(inputs[i]);
+        NodeBase *parent = source ? dynamic_cast<NodeBase *>(source->parent()) : 0;
+        if (parent && (! index.contains(parent)))
+          stack.append(parent);
+      }
+      continue;
+    }
+    stack.removeLast();
+
+    QByteArray inputs;
+    foreach (Socket *input, node->inputs()) {
+      Socket *source = findSource(input);
+      NodeBase *parent = source ? dynamic_cast<NodeBase *>(source->parent()) : 0;
+      inputs.append(input->name().toUtf8()).append(':');
+      if (parent && index.contains(parent))
+        inputs.append(QByteArray::number(index[parent])).append('.').append(source->name().toUtf8());
+      inputs.append(';');
+    }
+
+    int idx = index.size();
+    index.insert(node, idx);
+    hash.addData(QByteArray::number(idx));
+    hash.addData(node->metaObject()->className());
+    QStringList names = node->parameters().keys(); names.sort();
+    foreach (QString name, names) {
+      hash.addData(name.toUtf8());
+      hash.addData(node->parameter(name).asString().toUtf8());
+    }
+    hash.addData(inputs);
+  }
+  return index.value(root, -1);
 }
 
 bool
@@ -139,58 +264,46 @@ Network::save(const QString &file) {
 
 bool
 Network::load(const QDomDocument &doc, ParserInfo &info) {
-  clear();
-
-  QDomElement root = doc.documentElement();
-
-  // Get schema URL
-  QUrl schemaURL = QUrl("https://hmatuschek.github.io/stochbb/schema/network-1.0");
-  // First, check if Schema is known
-  QFile schemaFile("://xml/network-1.0.xml");
-  if (! schemaFile.open(QIODevice::ReadOnly)) {
-    QString text; QTextStream msg(&text);
-    msg << "Cannot open XML Schema file " << schemaFile.fileName() << ".";
-    info.addError(text); return false;
-  }
-
-  // Get schema
-  QXmlSchema schema;
-  schema.load(&schemaFile, schemaURL);
-  if (! schema.isValid()) {
-    QString text; QTextStream msg(&text);
-    msg << "Invalaid XML Schema " << schemaFile.fileName() << ".";
-    info.addError(text); return false;
-  }
-
-  // Validate document
-  QXmlSchemaValidator validator(schema);
-  SchemaMessageHandler msgHandler(info);
-  validator.setMessageHandler(&msgHandler);
-  if (! validator.validate(doc.toByteArray())) {
-    QString text; QTextStream msg(&text);
-    msg << "Validation failed.";
-    info.addError(text); return false;
-  }
+  NetModel model;
+  if (! model.load(doc, info))
+    return false;
+  return setModel(model, info);
+}
 
-  QHash<QString, NodeBase *> node_table;
+bool
+Network::setModel(const NetModel &model, ParserInfo &info) {
+  clear();
 
-  // Iterate over all "node" children
-  QDomElement node = root.firstChildElement("node");
-  for (; ! node.isNull(); node = node.nextSiblingElement("node")) {
-    NodeBase *obj = NodeBase::fromXml(node, info, node_table);
+  // Create the nodes, the model handle of each node is its index
+  QVector<NodeBase *> nodes(model.numNodes(), 0);
+  QHash<QString, NodeBase *> nodeTable;
+  for (int i=0; i<model.numNodes(); i++) {
+    NodeBase *obj = NodeBase::fromModel(model, i, info, nodeTable);
     if (! obj)
       return false;
-    node_table.insert(node.attribute("id"), obj);
+    nodes[i] = obj;
+    nodeTable.insert(model.node(i).id, obj);
     this->addNode(obj);
   }
 
-  // Iterate over all "edge" children
-  QDomElement edge = root.firstChildElement("edge");
-  for (; ! edge.isNull(); edge = edge.nextSiblingElement("edge")) {
-    Edge *obj = Edge::fromXml(edge, node_table, info);
-    if (! obj)
+  // Connect the sockets
+  for (int i=0; i<model.numEdges(); i++) {
+    const NetModel::Socket &src = model.socket(model.edge(i).src);
+    const NetModel::Socket &dest = model.socket(model.edge(i).dest);
+    if (! nodes[src.node]->hasSocket(src.name)) {
+      QString text; QTextStream msg(&text);
+      msg << "@line " << model.edge(i).line << ": Source node has no socket '" << src.name << "'.";
+      info.addError(text);
+      return false;
+    }
+    if (! nodes[dest.node]->hasSocket(dest.name)) {
+      QString text; QTextStream msg(&text);
+      msg << "@line " << model.edge(i).line << ": Destination node has no socket '"
+          << dest.name << "'.";
+      info.addError(text);
       return false;
-    this->addEdge(obj);
+    }
+    this->addEdge(new Edge(nodes[src.node]->socket(src.name), nodes[dest.node]->socket(dest.name)));
   }
 
   setModified(false);
@@ -198,20 +311,27 @@ Network::load(const QDomDocument &doc, ParserInfo &info) {
   return true;
 }
 
-QDomDocument
-Network::serialize() const {
-  QDomDocument doc;
-  QDomElement root = doc.createElement("net");
+NetModel
+Network::model() const {
+  // Each node adds itself with its type and parameters
+  NetModel model;
   foreach (QNetNode *obj, _nodes) {
-    if (NodeBase *node = dynamic_cast<NodeBase *>(obj)) {
-      root.appendChild(node->serialize(doc));
-    }
+    if (NodeBase *node = dynamic_cast<NodeBase *>(obj))
+      node->addToModel(model);
   }
   foreach (QNetEdge *obj, _edges) {
-    if (Edge *edge = dynamic_cast<Edge *>(obj)) {
-      root.appendChild(edge->serialize(doc));
-    }
+    Socket *src = dynamic_cast<Socket *>(obj->src());
+    Socket *dest = dynamic_cast<Socket *>(obj->dest());
+    if ((! src) || (! dest))
+      continue;
+    int srcNode = model.findNode(dynamic_cast<NodeBase *>(src->parent())->id());
+    int destNode = model.findNode(dynamic_cast<NodeBase *>(dest->parent())->id());
+    model.addEdge(model.addSocket(srcNode, src->name()), model.addSocket(destNode, dest->name()));
   }
-  doc.appendChild(root);
-  return doc;
+  return model;
+}
+
+QDomDocument
+Network::serialize() const {
+  return model().serialize();
 }
@@ -3,25 +3,10 @@
 
 #include "qnetview.hh"
 #include <QDomDocument>
-#include <QAbstractMessageHandler>
+#include <QCryptographicHash>
 #include "nodes.hh"
-
-
-
-class SchemaMessageHandler: public QAbstractMessageHandler
-{
-  Q_OBJECT
-
-public:
-  SchemaMessageHandler(ParserInfo &info, QObject *parent=0);
-
-protected:
-  void handleMessage(QtMsgType type, const QString &description,
-                     const QUrl &identifier, const QSourceLocation &sourceLocation);
-
-protected:
-  ParserInfo &_info;
-};
+#include "assembler.hh"
+#include "netmodel.hh"
 
 
 class Network : public QNetView
@@ -33,22 +18,45 @@ public:
 
   virtual bool canConnect(QNetSocket *a, QNetSocket *b);
   virtual void addConnection(QNetSocket *a, QNetSocket *b);
+  virtual void addEdge(QNetEdge *edge);
+  virtual void remEdge(QNetEdge *edge);
   Socket *findSource(Socket *dest);
 
   bool hasFilename() const;
   QString filename() const;
 
-  virtual void clear();
+  void invalidate(NodeBase *node);
+  Assembler::Mode assemblyMode() const;
+  void setAssemblyMode(Assembler::Mode mode);
+  bool assemble(Messages &messages);
+  const QHash<Socket *, stochbb::Var> &variables() const;
+  quint64 structuralHash(Socket *socket);
+  QByteArray samplingKey(const QVector<Socket *> &sources);
 
 public slots:
+  virtual void addNode(QNetNode *node);
+  virtual void remNode(QNetNode *node);
+  virtual void clear();
+
   bool load(const QString &file, ParserInfo &info);
   bool load(const QDomDocument &doc, ParserInfo &info);
+  bool setModel(const NetModel &model, ParserInfo &info);
+  NetModel model() const;
   bool save();
   bool save(const QString &file);
   QDomDocument serialize() const;
 
+protected:
+  void invalidateDestinations(QNetSocket *src);
+  int addSamplingKey(NodeBase *root, QHash<NodeBase *, int> &index, QCryptographicHash &hash);
+
 protected:
   QString _filepath;
+  QHash<Socket *, stochbb::Var> _varTable;
+  QHash<Socket *, Term> _termTable;
+  QHash<Socket *, quint64> _hashTable;
+  QSet<NodeBase *> _invalid;
+  Assembler::Mode _assemblyMode;
 };
 
 #endif // NETWORK_HH
@@ -2,12 +2,14 @@
 #include "network.hh"
 #include "assembler.hh"
 #include "plotwindow.hh"
+#include "netmodel.hh"
 #include <sstream>
 #include <QFormLayout>
 #include <QLineEdit>
 #include <QDoubleValidator>
 #include <QLabel>
 #include <QDialogButtonBox>
+#include <QThreadPool>
 
 
 /* ********************************************************************************************* *
@@ -30,34 +32,34 @@ Socket::name() const {
  * ********************************************************************************************* */
 QHash<QString, NodeBase::nodeFactoryFunction>
 NodeBase::_factoryFunctions({
-  {"delay",        (NodeBase::nodeFactoryFunction) DelayNode::fromXml},
-  {"rdelay",       (NodeBase::nodeFactoryFunction) RandomDelayNode::fromXml},
-  {"trigger",      (NodeBase::nodeFactoryFunction) TriggerNode::fromXml},
-  {"gammap",       (NodeBase::nodeFactoryFunction) GammaProcessNode::fromXml},
-  {"cgammap",      (NodeBase::nodeFactoryFunction) CompoundGammaProcessNode::fromXml},
-  {"invgammap",    (NodeBase::nodeFactoryFunction) InvGammaProcessNode::fromXml},
-  {"cinvgammap",   (NodeBase::nodeFactoryFunction) CompoundInvGammaProcessNode::fromXml},
-  {"weibullp",     (NodeBase::nodeFactoryFunction) WeibullProcessNode::fromXml},
-  {"cweibullp",    (NodeBase::nodeFactoryFunction) CompoundWeibullProcessNode::fromXml},
-  {"minimum",      (NodeBase::nodeFactoryFunction) MinimumNode::fromXml},
-  {"maximum",      (NodeBase::nodeFactoryFunction) MaximumNode::fromXml},
-  {"inhibition",   (NodeBase::nodeFactoryFunction) InhibitionNode::fromXml},
-  {"join",         (NodeBase::nodeFactoryFunction) JoinNode::fromXml},
-  {"affine",       (NodeBase::nodeFactoryFunction) AffineNode::fromXml},
-  {"const",        (NodeBase::nodeFactoryFunction) ConstantNode::fromXml},
-  {"unifv",        (NodeBase::nodeFactoryFunction) UniformVarNode::fromXml},
-  {"normv",        (NodeBase::nodeFactoryFunction) NormalVarNode::fromXml},
-  {"cnormalv",     (NodeBase::nodeFactoryFunction) CompoundNormalVarNode::fromXml},
-  {"gammav",       (NodeBase::nodeFactoryFunction) GammaVarNode::fromXml},
-  {"cgammav",      (NodeBase::nodeFactoryFunction) CompoundGammaVarNode::fromXml},
-  {"invgammav",    (NodeBase::nodeFactoryFunction) InvGammaVarNode::fromXml},
-  {"cinvgammav",   (NodeBase::nodeFactoryFunction) CompoundInvGammaVarNode::fromXml},
-  {"weibullv",     (NodeBase::nodeFactoryFunction) WeibullVarNode::fromXml},
-  {"cweibullv",    (NodeBase::nodeFactoryFunction) CompoundWeibullVarNode::fromXml},
-  {"marginalplot", (NodeBase::nodeFactoryFunction) MarginalPlotNode::fromXml},
-  {"scatterplot",  (NodeBase::nodeFactoryFunction) ScatterPlotNode::fromXml},
-  {"kdeplot",      (NodeBase::nodeFactoryFunction) KDEPlotNode::fromXml},
-  {"sampledump",   (NodeBase::nodeFactoryFunction) SampleDumpNode::fromXml}});
+  {"delay",        (NodeBase::nodeFactoryFunction) DelayNode::fromModel},
+  {"rdelay",       (NodeBase::nodeFactoryFunction) RandomDelayNode::fromModel},
+  {"trigger",      (NodeBase::nodeFactoryFunction) TriggerNode::fromModel},
+  {"gammap",       (NodeBase::nodeFactoryFunction) GammaProcessNode::fromModel},
+  {"cgammap",      (NodeBase::nodeFactoryFunction) CompoundGammaProcessNode::fromModel},
+  {"invgammap",    (NodeBase::nodeFactoryFunction) InvGammaProcessNode::fromModel},
+  {"cinvgammap",   (NodeBase::nodeFactoryFunction) CompoundInvGammaProcessNode::fromModel},
+  {"weibullp",     (NodeBase::nodeFactoryFunction) WeibullProcessNode::fromModel},
+  {"cweibullp",    (NodeBase::nodeFactoryFunction) CompoundWeibullProcessNode::fromModel},
+  {"minimum",      (NodeBase::nodeFactoryFunction) MinimumNode::fromModel},
+  {"maximum",      (NodeBase::nodeFactoryFunction) MaximumNode::fromModel},
+  {"inhibition",   (NodeBase::nodeFactoryFunction) InhibitionNode::fromModel},
+  {"join",         (NodeBase::nodeFactoryFunction) JoinNode::fromModel},
+  {"affine",       (NodeBase::nodeFactoryFunction) AffineNode::fromModel},
+  {"const",        (NodeBase::nodeFactoryFunction) ConstantNode::fromModel},
+  {"unifv",        (NodeBase::nodeFactoryFunction) UniformVarNode::fromModel},
+  {"normv",        (NodeBase::nodeFactoryFunction) NormalVarNode::fromModel},
+  {"cnormalv",     (NodeBase::nodeFactoryFunction) CompoundNormalVarNode::fromModel},
+  {"gammav",       (NodeBase::nodeFactoryFunction) GammaVarNode::fromModel},
+  {"cgammav",      (NodeBase::nodeFactoryFunction) CompoundGammaVarNode::fromModel},
+  {"invgammav",    (NodeBase::nodeFactoryFunction) InvGammaVarNode::fromModel},
+  {"cinvgammav",   (NodeBase::nodeFactoryFunction) CompoundInvGammaVarNode::fromModel},
+  {"weibullv",     (NodeBase::nodeFactoryFunction) WeibullVarNode::fromModel},
+  {"cweibullv",    (NodeBase::nodeFactoryFunction) CompoundWeibullVarNode::fromModel},
+  {"marginalplot", (NodeBase::nodeFactoryFunction) MarginalPlotNode::fromModel},
+  {"scatterplot",  (NodeBase::nodeFactoryFunction) ScatterPlotNode::fromModel},
+  {"kdeplot",      (NodeBase::nodeFactoryFunction) KDEPlotNode::fromModel},
+  {"sampledump",   (NodeBase::nodeFactoryFunction) SampleDumpNode::fromModel}});
 
 
 NodeBase::NodeBase(const QString &label, QNetView *parent)
@@ -123,6 +125,11 @@ NodeBase::socket(const QString &name) const {
   return _sockets[name];
 }
 
+QList<Socket *>
+NodeBase::sockets() const {
+  return _sockets.values();
+}
+
 void
 NodeBase::addSocket(QNetSocket *obj) {
   QNetNode::addSocket(obj);
@@ -131,27 +138,37 @@ NodeBase::addSocket(QNetSocket *obj) {
   }
 }
 
-QDomElement
-NodeBase::serialize(QDomDocument &doc) const {
-  QDomElement node = doc.createElement("node");
-  node.setAttribute("id", _id);
-  node.setAttribute("x", position().x());
-  node.setAttribute("y", position().y());
-  node.setAttribute("label", label());
+QList<Socket *>
+NodeBase::inputs() const {
+  // By default, all sockets on the left side are inputs
+  QList<Socket *> sockets;
+  for (size_t i=0; i<numSockets(QNetSocket::LEFT); i++) {
+    if (Socket *sock = dynamic_cast<Socket *>(socketAt(QNetSocket::LEFT, i)))
+      sockets.append(sock);
+  }
+  return sockets;
+}
 
+int
+NodeBase::addToModel(NetModel &model, const QString &type, const QString &sibling) const {
+  NetModel::Node node;
+  node.id = _id;
+  node.type = type;
+  node.label = label();
+  node.description = hasDescription() ? description() : QString();
+  node.position = position();
+  node.sibling = sibling;
+  node.line = 0;
+
+  QList<NetModel::Param> params;
   QHash<QString, Parameter>::const_iterator param = _params.begin();
   for (; param != _params.end(); param++) {
-    QDomElement pnode = param.value().serialize(doc);
-    pnode.setAttribute("name", param.key());
-    node.appendChild(pnode);
-  }
-
-  if (hasDescription()) {
-    QDomElement descr = doc.createElement("description");
-    descr.appendChild(doc.createTextNode(description()));
-    node.appendChild(descr);
+    NetModel::Param p;
+    p.name = param.key();
+    p.value = param.value();
+    params.append(p);
   }
-  return node;
+  return model.addNode(node, params);
 }
 
 bool
@@ -182,64 +199,39 @@ NodeBase::processable(Assembler &assembler) const {
 
 
 NodeBase *
-NodeBase::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
-  // Check if node has 'type' attribute
-  if (! node.hasAttribute("type")) {
-    QString text; QTextStream msg(&text);
-    msg << "@line " << node.lineNumber() << ": Node " << node.tagName()
-        << " has no 'type' attribute.";
-    info.addError(text);
-    return 0;
-  }
-
+NodeBase::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+  const NetModel::Node &item = model.node(node);
 
   // Dispatch by type
   NodeBase *obj = 0;
-  if (_factoryFunctions.contains(node.attribute("type"))) {
-    obj = _factoryFunctions[node.attribute("type")](node, info, nodeTable);
+  if (_factoryFunctions.contains(item.type)) {
+    obj = _factoryFunctions[item.type](model, node, info, nodeTable);
   } else {
     QString text; QTextStream msg(&text);
-    msg << "@line " << node.lineNumber() << ": Unknown node type '"
-        << node.attribute("type") << "'.";
+    msg << "@line " << item.line << ": Unknown node type '" << item.type << "'.";
     info.addError(text);
     return 0;
   }
-
-  QPoint pos(obj->position());
-  if (node.hasAttribute("x"))
-    pos.setX(node.attribute("x").toInt());
-  else {
+  if (! obj) {
     QString text; QTextStream msg(&text);
-    msg << "@line " << node.lineNumber() << ": Node has no 'x' attribute.";
-    info.addWarning(text);
-  }
-  if (node.hasAttribute("y"))
-    pos.setY(node.attribute("y").toInt());
-  else {
-    QString text; QTextStream msg(&text);
-    msg << "@line " << node.lineNumber() << ": Node has no 'y' attribute.";
-    info.addWarning(text);
+    msg << "@line " << item.line << ": Cannot create node " << item.id << " of type '"
+        << item.type << "'.";
+    info.addError(text);
+    return 0;
   }
-  obj->setPosition(pos);
-  if (node.hasAttribute("label"))
-    obj->setLabel(node.attribute("label"));
-  QDomElement descr = node.firstChildElement("description");
-  if (descr.isElement())
-    obj->setDescription(descr.text());
-
-  QDomElement param = node.firstChildElement("parameter");
-  for (; ! param.isNull(); param = param.nextSiblingElement("parameter")) {
-    if (param.hasAttribute("name")) {
-       if(! obj->setParameter(param.attribute("name"), Parameter::fromXml(param, info))) {
-         QString text; QTextStream msg(&text);
-         msg << "@line " << node.lineNumber() << ": Cannot set parameter '"
-             << param.attribute("name") << "' to '"
-             << param.text() << "'.";
-         info.addWarning(text);
-       }
-    } else {
+
+  obj->setPosition(item.position);
+  if (! item.label.isEmpty())
+    obj->setLabel(item.label);
+  if (! item.description.isEmpty())
+    obj->setDescription(item.description);
+
+  for (int i=0; i<item.numParameters; i++) {
+    const NetModel::Param &param = model.parameter(node, i);
+    if (! obj->setParameter(param.name, param.value)) {
       QString text; QTextStream msg(&text);
-      msg << "@line " << node.lineNumber() << ": 'parameter' element has no name.";
+      msg << "@line " << item.line << ": Cannot set parameter '" << param.name
+          << "' to '" << param.value.asString() << "'.";
       info.addWarning(text);
     }
   }
@@ -259,11 +251,9 @@ TriggerNode::TriggerNode(Network *parent)
   _type = "trigger";
 }
 
-QDomElement
-TriggerNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","trigger");
-  return node;
+int
+TriggerNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "trigger");
 }
 
 bool
@@ -271,12 +261,11 @@ TriggerNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::delta(parameter("time").asFloat(), label().toStdString()));
+  return assembler.addTerm(out, Term::delta(parameter("time").asFloat()), label());
 }
 
 TriggerNode *
-TriggerNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+TriggerNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return  new TriggerNode();
 }
 
@@ -296,26 +285,22 @@ DelayNode::DelayNode(Network *parent)
   _type = "fixed delay";
 }
 
-QDomElement
-DelayNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","delay");
-  return node;
+int
+DelayNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "delay");
 }
 
 bool
 DelayNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   if (! out || in.isNull())
     return false;
-  stochbb::Var res = stochbb::delta(parameter("delay").asFloat())+in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(out, Term::delta(parameter("delay").asFloat())+in, label());
 }
 
 DelayNode *
-DelayNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+DelayNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new DelayNode();
 }
 
@@ -332,27 +317,23 @@ RandomDelayNode::RandomDelayNode(Network *parent)
   _type = "random delay";
 }
 
-QDomElement
-RandomDelayNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","rdelay");
-  return node;
+int
+RandomDelayNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "rdelay");
 }
 
 bool
 RandomDelayNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
-  stochbb::Var d  = assembler.sourceVar(this, "delay");
+  Term in = assembler.sourceTerm(this, "in");
+  Term d  = assembler.sourceTerm(this, "delay");
   if (! out || in.isNull() || d.isNull())
     return false;
-  stochbb::Var res = d + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(out, d + in, label());
 }
 
 RandomDelayNode *
-RandomDelayNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+RandomDelayNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new RandomDelayNode();
 }
 
@@ -372,26 +353,23 @@ GammaProcessNode::GammaProcessNode(Network *parent)
   _type = "gamma process";
 }
 
-QDomElement
-GammaProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","gammap");
-  return node;
+int
+GammaProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "gammap");
 }
 
 bool
 GammaProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   if (!out || in.isNull())
     return false;
-  stochbb::Var res = stochbb::gamma(parameter("k").asFloat(), parameter("theta").asFloat()) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(
+        out, Term::gamma(parameter("k").asFloat(), parameter("theta").asFloat()) + in, label());
 }
 
 GammaProcessNode *
-GammaProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+GammaProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new GammaProcessNode();
 }
 
@@ -409,28 +387,24 @@ CompoundGammaProcessNode::CompoundGammaProcessNode(Network *parent)
   _type = "compound gamma process";
 }
 
-QDomElement
-CompoundGammaProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cgammap");
-  return node;
+int
+CompoundGammaProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cgammap");
 }
 
 bool
 CompoundGammaProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   stochbb::Var k = assembler.sourceVar(this, "k");
   stochbb::Var theta = assembler.sourceVar(this, "theta");
   if (!out || in.isNull() || k.isNull() || theta.isNull())
     return false;
-  stochbb::Var res = stochbb::gamma(k, theta) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(out, Term(stochbb::gamma(k, theta)) + in, label());
 }
 
 CompoundGammaProcessNode *
-CompoundGammaProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundGammaProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundGammaProcessNode();
 }
 
@@ -450,26 +424,23 @@ InvGammaProcessNode::InvGammaProcessNode(Network *parent)
   _type = "inverse gamma process";
 }
 
-QDomElement
-InvGammaProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","invgammap");
-  return node;
+int
+InvGammaProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "invgammap");
 }
 
 bool
 InvGammaProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   if (!out || in.isNull())
     return false;
-  stochbb::Var res = stochbb::invgamma(parameter("alpha").asFloat(), parameter("beta").asFloat()) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(
+        out, Term::invgamma(parameter("alpha").asFloat(), parameter("beta").asFloat()) + in, label());
 }
 
 InvGammaProcessNode *
-InvGammaProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+InvGammaProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new InvGammaProcessNode();
 }
 
@@ -487,28 +458,24 @@ CompoundInvGammaProcessNode::CompoundInvGammaProcessNode(Network *parent)
   _type = "compound inverse gamma process";
 }
 
-QDomElement
-CompoundInvGammaProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cinvgammap");
-  return node;
+int
+CompoundInvGammaProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cinvgammap");
 }
 
 bool
 CompoundInvGammaProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   stochbb::Var alpha = assembler.sourceVar(this, "alpha");
   stochbb::Var beta = assembler.sourceVar(this, "beta");
   if (!out || in.isNull() || alpha.isNull() || beta.isNull())
     return false;
-  stochbb::Var res = stochbb::invgamma(alpha, beta) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(out, Term(stochbb::invgamma(alpha, beta)) + in, label());
 }
 
 CompoundInvGammaProcessNode *
-CompoundInvGammaProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundInvGammaProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundInvGammaProcessNode();
 }
 
@@ -528,26 +495,23 @@ WeibullProcessNode::WeibullProcessNode(Network *parent)
   _type = "weibull process";
 }
 
-QDomElement
-WeibullProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","weibullp");
-  return node;
+int
+WeibullProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "weibullp");
 }
 
 bool
 WeibullProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   if (!out || in.isNull())
     return false;
-  stochbb::Var res = stochbb::weibull(parameter("k").asFloat(), parameter("lambda").asFloat()) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(
+        out, Term::weibull(parameter("k").asFloat(), parameter("lambda").asFloat()) + in, label());
 }
 
 WeibullProcessNode *
-WeibullProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+WeibullProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new WeibullProcessNode();
 }
 
@@ -566,28 +530,24 @@ CompoundWeibullProcessNode::CompoundWeibullProcessNode(Network *parent)
   _type = "compound weibull process";
 }
 
-QDomElement
-CompoundWeibullProcessNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cweibullp");
-  return node;
+int
+CompoundWeibullProcessNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cweibullp");
 }
 
 bool
 CompoundWeibullProcessNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   stochbb::Var k = assembler.sourceVar(this, "k");
   stochbb::Var lambda = assembler.sourceVar(this, "lambda");
   if (!out || in.isNull() || k.isNull() || lambda.isNull())
     return false;
-  stochbb::Var res = stochbb::weibull(k, lambda) + in;
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(out, Term(stochbb::weibull(k, lambda)) + in, label());
 }
 
 CompoundWeibullProcessNode *
-CompoundWeibullProcessNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundWeibullProcessNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundWeibullProcessNode();
 }
 
@@ -605,11 +565,9 @@ MinimumNode::MinimumNode(Network *parent)
   _type = "minimum";
 }
 
-QDomElement
-MinimumNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","minimum");
-  return node;
+int
+MinimumNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "minimum");
 }
 
 bool
@@ -625,7 +583,7 @@ MinimumNode::assemble(Assembler &assembler) const {
 }
 
 MinimumNode *
-MinimumNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+MinimumNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new MinimumNode();
 }
 
@@ -642,11 +600,9 @@ MaximumNode::MaximumNode(Network *parent)
   _type = "maximum";
 }
 
-QDomElement
-MaximumNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","maximum");
-  return node;
+int
+MaximumNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "maximum");
 }
 
 bool
@@ -662,7 +618,7 @@ MaximumNode::assemble(Assembler &assembler) const {
 }
 
 MaximumNode *
-MaximumNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+MaximumNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new MaximumNode();
 }
 
@@ -680,11 +636,9 @@ InhibitionNode::InhibitionNode(Network *parent)
   _type = "inhibition";
 }
 
-QDomElement
-InhibitionNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","inhibition");
-  return node;
+int
+InhibitionNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "inhibition");
 }
 
 bool
@@ -701,7 +655,7 @@ InhibitionNode::assemble(Assembler &assembler) const {
 }
 
 InhibitionNode *
-InhibitionNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+InhibitionNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new InhibitionNode();
 }
 
@@ -721,12 +675,18 @@ JoinNode::JoinNode(InhibitionNode *sibling, Network *parent)
   connect(this, SIGNAL(destroyed(QObject*)), _sibling, SLOT(deleteLater()));
 }
 
-QDomElement
-JoinNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","join");
-  node.setAttribute("sibling", _sibling->id());
-  return node;
+int
+JoinNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "join", _sibling->id());
+}
+
+QList<Socket *>
+JoinNode::inputs() const {
+  // The join node also depends on the inputs of its sibling
+  QList<Socket *> sockets = NodeBase::inputs();
+  sockets.append(_sibling->socket("X"));
+  sockets.append(_sibling->socket("Y"));
+  return sockets;
 }
 
 bool
@@ -744,12 +704,11 @@ JoinNode::assemble(Assembler &assembler) const {
 }
 
 JoinNode *
-JoinNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
-  if (! node.hasAttribute("sibling"))
-    return 0;
-  if (! nodeTable.contains(node.attribute("sibling")))
+JoinNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+  const QString &sibling = model.node(node).sibling;
+  if (! nodeTable.contains(sibling))
     return 0;
-  InhibitionNode *inh = dynamic_cast<InhibitionNode *>(nodeTable[node.attribute("sibling")]);
+  InhibitionNode *inh = dynamic_cast<InhibitionNode *>(nodeTable[sibling]);
   if (! inh)
     return 0;
   return new JoinNode(inh);
@@ -769,26 +728,23 @@ AffineNode::AffineNode(Network *parent)
   _type = "affine transform";
 }
 
-QDomElement
-AffineNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","affine");
-  return node;
+int
+AffineNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "affine");
 }
 
 bool
 AffineNode::assemble(Assembler &assembler) const {
-  stochbb::Var in = assembler.sourceVar(this, "in");
+  Term in = assembler.sourceTerm(this, "in");
   Socket *out = assembler.socket(this, "out");
   if (! out || in.isNull())
     return false;
-  stochbb::Var res = parameter("scale").asFloat() * in + parameter("shift").asFloat();
-  res.setName(label().toStdString());
-  return assembler.addVariable(out, res);
+  return assembler.addTerm(
+        out, in.affine(parameter("scale").asFloat(), parameter("shift").asFloat()), label());
 }
 
 AffineNode *
-AffineNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+AffineNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new AffineNode();
 }
 
@@ -804,11 +760,9 @@ ConstantNode::ConstantNode(Network *parent)
   _type = "constant";
 }
 
-QDomElement
-ConstantNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","const");
-  return node;
+int
+ConstantNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "const");
 }
 
 bool
@@ -816,11 +770,11 @@ ConstantNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(out, stochbb::delta(parameter("value").asFloat(), label().toStdString()));
+  return assembler.addTerm(out, Term::delta(parameter("value").asFloat()), label());
 }
 
 ConstantNode *
-ConstantNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+ConstantNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new ConstantNode();
 }
 
@@ -838,11 +792,9 @@ GammaVarNode::GammaVarNode(Network *parent)
   _type = "gamma variable";
 }
 
-QDomElement
-GammaVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","gammav");
-  return node;
+int
+GammaVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "gammav");
 }
 
 bool
@@ -850,12 +802,12 @@ GammaVarNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::gamma(parameter("k").asFloat(), parameter("theta").asFloat(), label().toStdString()));
+  return assembler.addTerm(
+        out, Term::gamma(parameter("k").asFloat(), parameter("theta").asFloat()), label());
 }
 
 GammaVarNode *
-GammaVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+GammaVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new GammaVarNode();
 }
 
@@ -872,11 +824,9 @@ CompoundGammaVarNode::CompoundGammaVarNode(Network *parent)
   _type = "compound gamma variable";
 }
 
-QDomElement
-CompoundGammaVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cgammav");
-  return node;
+int
+CompoundGammaVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cgammav");
 }
 
 bool
@@ -890,7 +840,7 @@ CompoundGammaVarNode::assemble(Assembler &assembler) const {
 }
 
 CompoundGammaVarNode *
-CompoundGammaVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundGammaVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundGammaVarNode();
 }
 
@@ -907,11 +857,9 @@ InvGammaVarNode::InvGammaVarNode(Network *parent)
   _type = "inverse gamma variable";
 }
 
-QDomElement
-InvGammaVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","invgammav");
-  return node;
+int
+InvGammaVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "invgammav");
 }
 
 bool
@@ -919,12 +867,12 @@ InvGammaVarNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::invgamma(parameter("alpha").asFloat(), parameter("beta").asFloat(), label().toStdString()));
+  return assembler.addTerm(
+        out, Term::invgamma(parameter("alpha").asFloat(), parameter("beta").asFloat()), label());
 }
 
 InvGammaVarNode *
-InvGammaVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+InvGammaVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new InvGammaVarNode();
 }
 
@@ -941,11 +889,9 @@ CompoundInvGammaVarNode::CompoundInvGammaVarNode(Network *parent)
   _type = "compound inverse gamma variable";
 }
 
-QDomElement
-CompoundInvGammaVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cinvgammav");
-  return node;
+int
+CompoundInvGammaVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cinvgammav");
 }
 
 bool
@@ -959,7 +905,7 @@ CompoundInvGammaVarNode::assemble(Assembler &assembler) const {
 }
 
 CompoundInvGammaVarNode *
-CompoundInvGammaVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundInvGammaVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundInvGammaVarNode();
 }
 
@@ -976,11 +922,9 @@ WeibullVarNode::WeibullVarNode(Network *parent)
   _type = "weibull variable";
 }
 
-QDomElement
-WeibullVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","weibullv");
-  return node;
+int
+WeibullVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "weibullv");
 }
 
 bool
@@ -988,12 +932,12 @@ WeibullVarNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::weibull(parameter("k").asFloat(), parameter("lambda").asFloat(), label().toStdString()));
+  return assembler.addTerm(
+        out, Term::weibull(parameter("k").asFloat(), parameter("lambda").asFloat()), label());
 }
 
 WeibullVarNode *
-WeibullVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+WeibullVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new WeibullVarNode();
 }
 
@@ -1010,11 +954,9 @@ CompoundWeibullVarNode::CompoundWeibullVarNode(Network *parent)
   _type = "compound weibull variable";
 }
 
-QDomElement
-CompoundWeibullVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cweibullv");
-  return node;
+int
+CompoundWeibullVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cweibullv");
 }
 
 bool
@@ -1028,7 +970,7 @@ CompoundWeibullVarNode::assemble(Assembler &assembler) const {
 }
 
 CompoundWeibullVarNode *
-CompoundWeibullVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundWeibullVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundWeibullVarNode();
 }
 
@@ -1045,11 +987,9 @@ UniformVarNode::UniformVarNode(Network *parent)
   _type = "uniform variable";
 }
 
-QDomElement
-UniformVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","unifv");
-  return node;
+int
+UniformVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "unifv");
 }
 
 bool
@@ -1057,12 +997,12 @@ UniformVarNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::uniform(parameter("min").asFloat(), parameter("max").asFloat(), label().toStdString()));
+  return assembler.addTerm(
+        out, Term::uniform(parameter("min").asFloat(), parameter("max").asFloat()), label());
 }
 
 UniformVarNode *
-UniformVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+UniformVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new UniformVarNode();
 }
 
@@ -1079,11 +1019,9 @@ NormalVarNode::NormalVarNode(Network *parent)
   _type = "normal variable";
 }
 
-QDomElement
-NormalVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","normv");
-  return node;
+int
+NormalVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "normv");
 }
 
 bool
@@ -1091,12 +1029,12 @@ NormalVarNode::assemble(Assembler &assembler) const {
   Socket *out = assembler.socket(this, "out");
   if (! out)
     return false;
-  return assembler.addVariable(
-        out, stochbb::normal(parameter("mu").asFloat(), parameter("sigma").asFloat(), label().toStdString()));
+  return assembler.addTerm(
+        out, Term::normal(parameter("mu").asFloat(), parameter("sigma").asFloat()), label());
 }
 
 NormalVarNode *
-NormalVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+NormalVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new NormalVarNode();
 }
 
@@ -1113,11 +1051,9 @@ CompoundNormalVarNode::CompoundNormalVarNode(Network *parent)
   _type = "normal variable";
 }
 
-QDomElement
-CompoundNormalVarNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type","cnormalv");
-  return node;
+int
+CompoundNormalVarNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "cnormalv");
 }
 
 bool
@@ -1131,7 +1067,7 @@ CompoundNormalVarNode::assemble(Assembler &assembler) const {
 }
 
 CompoundNormalVarNode *
-CompoundNormalVarNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+CompoundNormalVarNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new CompoundNormalVarNode();
 }
 
@@ -1150,6 +1086,44 @@ OutputNode::assemble(Assembler &assembler) const {
   return true;
 }
 
+QMainWindow *
+OutputNode::createWindow(const QHash<Socket *, stochbb::Var> &vartable, QString &error) {
+  // Runs the task synchronously
+  OutputTask *task = createTask(vartable);
+  if (! task)
+    return 0;
+  QMainWindow *win = 0;
+  if (task->run())
+    win = task->createWindow();
+  else
+    error = task->error();
+  delete task;
+  return win;
+}
+
+Socket *
+OutputNode::sampleSource(Socket *sock) {
+  // Samples are shared between all inputs connected to the same source
+  Network *net = qobject_cast<Network *>(parent());
+  return net ? net->findSource(sock) : 0;
+}
+
+void
+OutputNode::execute(const QHash<Socket *, stochbb::Var> &vartable) {
+  QString error;
+  QMainWindow *win = 0;
+  try {
+    win = createWindow(vartable, error);
+  } catch (stochbb::Error &err) {
+    error = err.what();
+  }
+  if (win) {
+    win->show();
+  } else if (! error.isEmpty()) {
+    QMessageBox::critical(0, tr("Cannot execute %1.").arg(label()), error);
+  }
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of MarginalPlotNode
@@ -1178,49 +1152,48 @@ MarginalPlotNode::setParameter(const QString &name, const Parameter &param) {
   return NodeBase::setParameter(name, param);
 }
 
-void
-MarginalPlotNode::execute(const QHash<Socket *, stochbb::Var> &vartable) {
+OutputTask *
+MarginalPlotNode::createTask(const QHash<Socket *, stochbb::Var> &vartable, QSharedPointer<SampleSet> samples) {
   if (0 == numSockets(QNetSocket::LEFT))
-    return;
+    return 0;
 
+  // Structural hashes identify marginals of equivalent sub-networks, these share a single
+  // density evaluation across all marginal plots of the run
+  Network *net = qobject_cast<Network *>(parent());
   QVector<stochbb::Var> vars;
+  QVector<quint64> keys;
+  QVector<QByteArray> cacheKeys;
   for (size_t i=0; i<numSockets(QNetSocket::LEFT); i++) {
-    stochbb::Var X = vartable[socket(QString::number(i+1))];
+    Socket *sock = socket(QString::number(i+1));
+    stochbb::Var X = vartable[sock];
     if (X.isNull())
       continue;
     vars.push_back(X);
+    keys.push_back(net ? net->structuralHash(sock) : 0);
+    // The canonical key of the upstream network identifies the grids across runs
+    cacheKeys.push_back(net ? net->samplingKey(QVector<Socket *>() << sampleSource(sock)) : QByteArray());
   }
 
-  // check if the density for each marginal can be derived
-  for (size_t i=0; i<vars.size(); i++) {
-    try {
-      vars[i].density();
-    } catch (stochbb::Error &err) {
-      QMessageBox::critical(
-            0, tr("Cannot derive density."),
-            tr("Cannot derive density for marginal %0 (slot %1): %2")
-            .arg(vars[i].name().c_str()).arg(i+1).arg(err.what()));
-      return;
-    }
-  }
   size_t nstep = parameter("steps").asInt() > 0 ? parameter("steps").asInt() : 100;
   double tmin = parameter("min").asFloat(), tmax = parameter("max").asFloat();
 
-  MarginalPlotWindow *plot = new MarginalPlotWindow(tmin, tmax, nstep, vars);
-  plot->resize(480, 320);
-  plot->setWindowTitle(this->label());
-  plot->show();
+  // The task checks whether the density for each marginal can be derived. Densities are evaluated
+  // concurrently, independent of the number of threads drawing samples.
+  int threads = QThreadPool::globalInstance()->maxThreadCount();
+  MarginalPlotTask *task = new MarginalPlotTask(label(), tmin, tmax, nstep, vars, keys, threads);
+  task->setCacheKeys(cacheKeys);
+  if (samples)
+    task->setDensitySet(samples->densities());
+  return task;
 }
 
-QDomElement
-MarginalPlotNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type", "marginalplot");
-  return node;
+int
+MarginalPlotNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "marginalplot");
 }
 
 MarginalPlotNode *
-MarginalPlotNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+MarginalPlotNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new MarginalPlotNode();
 }
 
@@ -1234,31 +1207,37 @@ ScatterPlotNode::ScatterPlotNode(Network *parent)
   addSocket(new Socket(QNetSocket::LEFT, "X", "X", this));
   addSocket(new Socket(QNetSocket::LEFT, "Y", "Y", this));
   _params.insert("samples", Parameter(1000));
+  _params.insert("bins", Parameter(0));
+  _params.insert("overlay", Parameter(1000));
   _type = "scatter plot";
 }
 
-void
-ScatterPlotNode::execute(const QHash<Socket *, stochbb::Var> &vartable) {
+OutputTask *
+ScatterPlotNode::createTask(const QHash<Socket *, stochbb::Var> &vartable, QSharedPointer<SampleSet> samples) {
   stochbb::Var X = vartable[socket("X")];
   stochbb::Var Y = vartable[socket("Y")];
+  if (X.isNull() || Y.isNull())
+    return 0;
 
-  size_t samples = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
+  size_t nsample = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
+  if (samples.isNull())
+    samples = QSharedPointer<SampleSet>(new SampleSet());
+  int xcol = samples->add(sampleSource(socket("X")), X, nsample);
+  int ycol = samples->add(sampleSource(socket("Y")), Y, nsample);
+  // If bins > 0, the joint samples are shown as a 2D histogram with a subsample on top
+  int bins = std::max(0, parameter("bins").asInt());
+  size_t overlay = std::max(0, parameter("overlay").asInt());
 
-  ScatterPlotWindow *plot = new ScatterPlotWindow(samples, X, Y);
-  plot->resize(480, 320);
-  plot->setWindowTitle(this->label());
-  plot->show();
+  return new ScatterPlotTask(label(), samples, nsample, X, xcol, Y, ycol, bins, overlay);
 }
 
-QDomElement
-ScatterPlotNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type", "scatterplot");
-  return node;
+int
+ScatterPlotNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "scatterplot");
 }
 
 ScatterPlotNode *
-ScatterPlotNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+ScatterPlotNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new ScatterPlotNode();
 }
 
@@ -1271,6 +1250,8 @@ KDEPlotNode::KDEPlotNode(Network *parent)
 {
   _params.insert("graphs", Parameter(0));
   _params.insert("samples", Parameter(1000));
+  // Either "auto", "exact" or "binned", see KDE::Mode
+  _params.insert("mode", Parameter(QString("auto")));
 
   _type = "KDE plot";
 }
@@ -1285,39 +1266,49 @@ KDEPlotNode::setParameter(const QString &name, const Parameter &param) {
       addSocket(new Socket(QNetSocket::LEFT, QString::number(n), QString::number(n), this));
       n++;
     }
+  } else if ("mode" == name) {
+    if (! (QStringList() << "auto" << "exact" << "binned").contains(param.asString().toLower()))
+      return false;
   }
   return NodeBase::setParameter(name, param);
 }
 
-void
-KDEPlotNode::execute(const QHash<Socket *, stochbb::Var> &vartable) {
+OutputTask *
+KDEPlotNode::createTask(const QHash<Socket *, stochbb::Var> &vartable, QSharedPointer<SampleSet> samples) {
   if (0 == numSockets(QNetSocket::LEFT))
-    return;
+    return 0;
+  size_t nsample = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
+  if (samples.isNull())
+    samples = QSharedPointer<SampleSet>(new SampleSet());
   QVector<stochbb::Var> vars;
+  QVector<int> columns;
   for (size_t i=0; i<numSockets(QNetSocket::LEFT); i++) {
-    stochbb::Var X = vartable[socket(QString::number(i+1))];
+    Socket *sock = socket(QString::number(i+1));
+    stochbb::Var X = vartable[sock];
     if (X.isNull())
       continue;
     vars.push_back(X);
+    columns.push_back(samples->add(sampleSource(sock), X, nsample));
   }
+  if (vars.isEmpty())
+    return 0;
 
-  size_t nsample = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
+  KDE::Mode mode = KDE::AUTO;
+  if ("exact" == parameter("mode").asString().toLower())
+    mode = KDE::EXACT;
+  else if ("binned" == parameter("mode").asString().toLower())
+    mode = KDE::BINNED;
 
-  KDEPlotWindow *plot = new KDEPlotWindow(nsample, vars);
-  plot->resize(480, 320);
-  plot->setWindowTitle(this->label());
-  plot->show();
+  return new KDEPlotTask(label(), samples, nsample, vars, columns, mode);
 }
 
-QDomElement
-KDEPlotNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type", "kdeplot");
-  return node;
+int
+KDEPlotNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "kdeplot");
 }
 
 KDEPlotNode *
-KDEPlotNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+KDEPlotNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new KDEPlotNode();
 }
 
@@ -1330,6 +1321,7 @@ SampleDumpNode::SampleDumpNode(Network *parent)
 {
   _params.insert("variables", Parameter(0));
   _params.insert("samples", Parameter(1000));
+  _params.insert("block", Parameter(10000));
 
   _type = "Sample Dump";
 }
@@ -1348,33 +1340,40 @@ SampleDumpNode::setParameter(const QString &name, const Parameter &param) {
   return NodeBase::setParameter(name, param);
 }
 
-void
-SampleDumpNode::execute(const QHash<Socket *, stochbb::Var> &vartable) {
+OutputTask *
+SampleDumpNode::createTask(const QHash<Socket *, stochbb::Var> &vartable, QSharedPointer<SampleSet> samples) {
   if (0 == numSockets(QNetSocket::LEFT))
-    return;
+    return 0;
+  size_t nsample = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
+  size_t block = parameter("block").asInt() > 0 ? parameter("block").asInt() : 10000;
+  if (samples.isNull())
+    samples = QSharedPointer<SampleSet>(new SampleSet());
+
+  // Dumps are streamed block-wise into the file, hence they request no rows of the shared
+  // sampling pass held in memory. They still share its realisations and its cache.
   QVector<stochbb::Var> vars;
+  QVector<int> columns;
   for (size_t i=0; i<numSockets(QNetSocket::LEFT); i++) {
-    stochbb::Var X = vartable[socket(QString::number(i+1))];
+    Socket *sock = socket(QString::number(i+1));
+    stochbb::Var X = vartable[sock];
     if (X.isNull())
       continue;
     vars.push_back(X);
+    columns.push_back(samples->add(sampleSource(sock), X, 0));
   }
+  if (vars.isEmpty())
+    return 0;
 
-  size_t nsample = parameter("samples").asInt() > 0 ? parameter("samples").asInt() : 1000;
-  SampleDumpWindow *win = new SampleDumpWindow(nsample, vars);
-  win->setWindowTitle(this->label());
-  win->show();
+  return new SampleDumpTask(label(), samples, nsample, block, vars, columns);
 }
 
-QDomElement
-SampleDumpNode::serialize(QDomDocument &doc) const {
-  QDomElement node = NodeBase::serialize(doc);
-  node.setAttribute("type", "kdeplot");
-  return node;
+int
+SampleDumpNode::addToModel(NetModel &model) const {
+  return NodeBase::addToModel(model, "kdeplot");
 }
 
 SampleDumpNode *
-SampleDumpNode::fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
+SampleDumpNode::fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable) {
   return new SampleDumpNode();
 }
 
@@ -3,15 +3,19 @@
 
 #include "qnetview.hh"
 #include <QHash>
-#include <QDomElement>
 #include <QDialog>
+#include <QSharedPointer>
 #include "parameter.hh"
 #include <stochbb/api.hh>
 
 
 class Network;
+class NetModel;
 class Assembler;
 class QLineEdit;
+class QMainWindow;
+class OutputTask;
+class SampleSet;
 
 
 class Socket: public QNetSocket
@@ -47,8 +51,10 @@ public:
 
   bool hasSocket(const QString &name) const;
   Socket *socket(const QString &name) const;
+  QList<Socket *> sockets() const;
   void addSocket(QNetSocket *socket);
-  virtual QDomElement serialize(QDomDocument &doc) const;
+  virtual QList<Socket *> inputs() const;
+  virtual int addToModel(NetModel &model) const = 0;
 
   virtual bool needsPreprocessing(Assembler &assembler) const;
   virtual bool preprocess(Assembler &assembler) const;
@@ -56,7 +62,10 @@ public:
   virtual bool assemble(Assembler &assembler) const = 0;
 
 public:
-  static NodeBase *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static NodeBase *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+
+protected:
+  int addToModel(NetModel &model, const QString &type, const QString &sibling=QString()) const;
 
 protected:
   QString _id;
@@ -64,7 +73,7 @@ protected:
   QHash<QString, Socket *> _sockets;
   QHash<QString, Parameter> _params;
 
-  typedef NodeBase *(*nodeFactoryFunction)(const QDomElement &, ParserInfo &, QHash<QString, NodeBase *> &);
+  typedef NodeBase *(*nodeFactoryFunction)(const NetModel &, int, ParserInfo &, QHash<QString, NodeBase *> &);
   static QHash<QString, nodeFactoryFunction> _factoryFunctions;
 };
 
@@ -76,11 +85,11 @@ class TriggerNode: public NodeBase
 public:
   TriggerNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static TriggerNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static TriggerNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -91,11 +100,11 @@ class DelayNode: public NodeBase
 public:
   DelayNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static DelayNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static DelayNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -106,11 +115,11 @@ class RandomDelayNode: public NodeBase
 public:
   RandomDelayNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static RandomDelayNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static RandomDelayNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -121,11 +130,11 @@ class GammaProcessNode: public NodeBase
 public:
   GammaProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static GammaProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static GammaProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -136,11 +145,11 @@ class CompoundGammaProcessNode: public NodeBase
 public:
   CompoundGammaProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundGammaProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundGammaProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -151,11 +160,11 @@ class InvGammaProcessNode: public NodeBase
 public:
   InvGammaProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static InvGammaProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static InvGammaProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -166,11 +175,11 @@ class CompoundInvGammaProcessNode: public NodeBase
 public:
   CompoundInvGammaProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundInvGammaProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundInvGammaProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -181,11 +190,11 @@ class WeibullProcessNode: public NodeBase
 public:
   WeibullProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static WeibullProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static WeibullProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -196,11 +205,11 @@ class CompoundWeibullProcessNode: public NodeBase
 public:
   CompoundWeibullProcessNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundWeibullProcessNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundWeibullProcessNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -211,11 +220,11 @@ class MinimumNode: public NodeBase
 public:
   MinimumNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static MinimumNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static MinimumNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -226,11 +235,11 @@ class MaximumNode: public NodeBase
 public:
   MaximumNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static MaximumNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static MaximumNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -241,11 +250,11 @@ class InhibitionNode: public NodeBase
 public:
   InhibitionNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   bool assemble(Assembler &assembler) const;
 
 public:
-  static InhibitionNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static InhibitionNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -256,12 +265,13 @@ class JoinNode: public NodeBase
 public:
   JoinNode(InhibitionNode *sibling, Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
 
+  QList<Socket *> inputs() const;
   bool assemble(Assembler &assembler) const;
 
 public:
-  static JoinNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static JoinNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 
 protected:
   InhibitionNode *_sibling;
@@ -275,11 +285,11 @@ class AffineNode: public NodeBase
 public:
   AffineNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static AffineNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static AffineNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -290,11 +300,11 @@ class ConstantNode: public NodeBase
 public:
   ConstantNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static ConstantNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static ConstantNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -305,11 +315,11 @@ class GammaVarNode: public NodeBase
 public:
   GammaVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static GammaVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static GammaVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -320,11 +330,11 @@ class CompoundGammaVarNode: public NodeBase
 public:
   CompoundGammaVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundGammaVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundGammaVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -335,11 +345,11 @@ class InvGammaVarNode: public NodeBase
 public:
   InvGammaVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static InvGammaVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static InvGammaVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -350,11 +360,11 @@ class CompoundInvGammaVarNode: public NodeBase
 public:
   CompoundInvGammaVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundInvGammaVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundInvGammaVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -365,11 +375,11 @@ class WeibullVarNode: public NodeBase
 public:
   WeibullVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static WeibullVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static WeibullVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -380,11 +390,11 @@ class CompoundWeibullVarNode: public NodeBase
 public:
   CompoundWeibullVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundWeibullVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundWeibullVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -395,11 +405,11 @@ class UniformVarNode: public NodeBase
 public:
   UniformVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static UniformVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static UniformVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -410,11 +420,11 @@ class NormalVarNode: public NodeBase
 public:
   NormalVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static NormalVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static NormalVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -425,11 +435,11 @@ class CompoundNormalVarNode: public NodeBase
 public:
   CompoundNormalVarNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  static CompoundNormalVarNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static CompoundNormalVarNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -442,7 +452,13 @@ protected:
   virtual bool assemble(Assembler &assembler) const;
 
 public:
-  virtual void execute(const QHash<Socket *, stochbb::Var> &vartable) = 0;
+  virtual void execute(const QHash<Socket *, stochbb::Var> &vartable);
+  QMainWindow *createWindow(const QHash<Socket *, stochbb::Var> &vartable, QString &error);
+  virtual OutputTask *createTask(const QHash<Socket *, stochbb::Var> &vartable,
+                                 QSharedPointer<SampleSet> samples=QSharedPointer<SampleSet>()) = 0;
+
+protected:
+  Socket *sampleSource(Socket *sock);
 };
 
 
@@ -454,12 +470,13 @@ public:
   MarginalPlotNode(Network *parent=0);
 
   bool setParameter(const QString &name, const Parameter &param);
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
 
-  void execute(const QHash<Socket *, stochbb::Var> &vartable);
+  OutputTask *createTask(const QHash<Socket *, stochbb::Var> &vartable,
+                         QSharedPointer<SampleSet> samples=QSharedPointer<SampleSet>());
 
 public:
-  static MarginalPlotNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static MarginalPlotNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -470,12 +487,13 @@ class ScatterPlotNode: public OutputNode
 public:
   ScatterPlotNode(Network *parent=0);
 
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
 
-  void execute(const QHash<Socket *, stochbb::Var> &vartable);
+  OutputTask *createTask(const QHash<Socket *, stochbb::Var> &vartable,
+                         QSharedPointer<SampleSet> samples=QSharedPointer<SampleSet>());
 
 public:
-  static ScatterPlotNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static ScatterPlotNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -487,12 +505,13 @@ public:
   KDEPlotNode(Network *parent=0);
 
   bool setParameter(const QString &name, const Parameter &param);
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
 
-  void execute(const QHash<Socket *, stochbb::Var> &vartable);
+  OutputTask *createTask(const QHash<Socket *, stochbb::Var> &vartable,
+                         QSharedPointer<SampleSet> samples=QSharedPointer<SampleSet>());
 
 public:
-  static KDEPlotNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static KDEPlotNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -504,12 +523,13 @@ public:
   SampleDumpNode(Network *parent=0);
 
   bool setParameter(const QString &name, const Parameter &param);
-  QDomElement serialize(QDomDocument &doc) const;
+  int addToModel(NetModel &model) const;
 
-  void execute(const QHash<Socket *, stochbb::Var> &vartable);
+  OutputTask *createTask(const QHash<Socket *, stochbb::Var> &vartable,
+                         QSharedPointer<SampleSet> samples=QSharedPointer<SampleSet>());
 
 public:
-  static SampleDumpNode *fromXml(const QDomElement &node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
+  static SampleDumpNode *fromModel(const NetModel &model, int node, ParserInfo &info, QHash<QString, NodeBase *> &nodeTable);
 };
 
 
@@ -0,0 +1,182 @@
+#include "plotdata.hh"
+
+
+// Moves the content of the given vector into a new shared buffer without copying
+static QSharedPointer<const Eigen::VectorXd>
+takeBuffer(Eigen::VectorXd &vec) {
+  Eigen::VectorXd *buffer = new Eigen::VectorXd();
+  buffer->swap(vec);
+  return QSharedPointer<const Eigen::VectorXd>(buffer);
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of PlotData
+ * ******************************************************************************************** */
+PlotData::PlotData()
+  : _x(new Eigen::VectorXd()), _y(new Eigen::VectorXd()), _buffer(), _xdata(0), _ydata(0), _size(0)
+{
+  attach();
+}
+
+PlotData::PlotData(const Eigen::VectorXd &x, const Eigen::VectorXd &y)
+  : _x(new Eigen::VectorXd(x)), _y(new Eigen::VectorXd(y)), _buffer(), _xdata(0), _ydata(0), _size(0)
+{
+  attach();
+}
+
+PlotData::PlotData(const PlotData &keys, const Eigen::VectorXd &y)
+  : _x(keys._x), _y(new Eigen::VectorXd(y)), _buffer(keys._buffer), _xdata(keys._xdata), _ydata(0),
+    _size(0)
+{
+  _ydata = _y->data();
+  _size = std::min(keys._size, size_t(_y->size()));
+}
+
+void
+PlotData::attach() {
+  _xdata = _x->data();
+  _ydata = _y->data();
+  _size = std::min(_x->size(), _y->size());
+}
+
+PlotData
+PlotData::adopt(Eigen::VectorXd &x, Eigen::VectorXd &y) {
+  PlotData data;
+  data._x = takeBuffer(x);
+  data._y = takeBuffer(y);
+  data.attach();
+  return data;
+}
+
+PlotData
+PlotData::adopt(const PlotData &keys, Eigen::VectorXd &y) {
+  PlotData data(keys);
+  data._y = takeBuffer(y);
+  data._ydata = data._y->data();
+  data._size = std::min(keys._size, size_t(data._y->size()));
+  return data;
+}
+
+PlotData
+PlotData::view(const QSharedPointer<const Eigen::MatrixXd> &buffer, int xcol, int ycol, size_t rows) {
+  // The columns of a column-major matrix are contiguous, hence they are shown in place
+  PlotData data;
+  data._buffer = buffer;
+  data._xdata = buffer->col(xcol).data();
+  data._ydata = buffer->col(ycol).data();
+  data._size = std::min(rows, size_t(buffer->rows()));
+  return data;
+}
+
+size_t
+PlotData::size() const {
+  return _size;
+}
+
+PlotData::Column
+PlotData::x() const {
+  return Column(_xdata, _size);
+}
+
+PlotData::Column
+PlotData::y() const {
+  return Column(_ydata, _size);
+}
+
+PlotData
+PlotData::head(size_t n) const {
+  // The head shares the buffers
+  PlotData data(*this);
+  data._size = std::min(n, _size);
+  return data;
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of PointCloud
+ * ******************************************************************************************** */
+PointCloud::PointCloud(QCPAxis *keyAxis, QCPAxis *valueAxis)
+  : QCPAbstractPlottable(keyAxis, valueAxis), _data(), _scatterStyle(QCPScatterStyle::ssPlus)
+{
+  // pass...
+}
+
+const PlotData &
+PointCloud::data() const {
+  return _data;
+}
+
+void
+PointCloud::setData(const PlotData &data) {
+  _data = data;
+}
+
+const QCPScatterStyle &
+PointCloud::scatterStyle() const {
+  return _scatterStyle;
+}
+
+void
+PointCloud::setScatterStyle(const QCPScatterStyle &style) {
+  _scatterStyle = style;
+}
+
+void
+PointCloud::clearData() {
+  _data = PlotData();
+}
+
+double
+PointCloud::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+  // Points are not selectable
+  return -1;
+}
+
+void
+PointCloud::draw(QCPPainter *painter) {
+  if ((! mKeyAxis) || (! mValueAxis) || _scatterStyle.isNone())
+    return;
+
+  // Points are drawn straight from the buffers, skipping those outside of the view
+  QCPRange keys = mKeyAxis->range(), values = mValueAxis->range();
+  PlotData::Column x = _data.x(), y = _data.y();
+  applyScattersAntialiasingHint(painter);
+  _scatterStyle.applyTo(painter, mPen);
+  for (size_t i=0; i<_data.size(); i++) {
+    if (keys.contains(x(i)) && values.contains(y(i)))
+      _scatterStyle.drawShape(painter, coordsToPixels(x(i), y(i)));
+  }
+}
+
+void
+PointCloud::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+  applyScattersAntialiasingHint(painter);
+  _scatterStyle.applyTo(painter, mPen);
+  _scatterStyle.drawShape(painter, rect.center());
+}
+
+QCPRange
+PointCloud::range(const PlotData::Column &values, bool &foundRange, SignDomain inSignDomain) {
+  QCPRange range(std::numeric_limits<double>::max(), -std::numeric_limits<double>::max());
+  foundRange = false;
+  for (int i=0; i<values.size(); i++) {
+    if (((sdNegative == inSignDomain) && (values(i) >= 0)) ||
+        ((sdPositive == inSignDomain) && (values(i) <= 0)))
+      continue;
+    range.lower = std::min(range.lower, values(i));
+    range.upper = std::max(range.upper, values(i));
+    foundRange = true;
+  }
+  return range;
+}
+
+QCPRange
+PointCloud::getKeyRange(bool &foundRange, SignDomain inSignDomain) const {
+  return range(_data.x(), foundRange, inSignDomain);
+}
+
+QCPRange
+PointCloud::getValueRange(bool &foundRange, SignDomain inSignDomain) const {
+  return range(_data.y(), foundRange, inSignDomain);
+}
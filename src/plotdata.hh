@@ -0,0 +1,68 @@
+#ifndef PLOTDATA_HH
+#define PLOTDATA_HH
+
+#include <QSharedPointer>
+#include <Eigen/Eigen>
+#include "qcustomplot.hh"
+
+
+class PlotData
+{
+public:
+  typedef Eigen::Map<const Eigen::VectorXd> Column;
+
+public:
+  PlotData();
+  PlotData(const Eigen::VectorXd &x, const Eigen::VectorXd &y);
+  PlotData(const PlotData &keys, const Eigen::VectorXd &y);
+
+  size_t size() const;
+  Column x() const;
+  Column y() const;
+  PlotData head(size_t n) const;
+
+  static PlotData adopt(Eigen::VectorXd &x, Eigen::VectorXd &y);
+  static PlotData adopt(const PlotData &keys, Eigen::VectorXd &y);
+  static PlotData view(const QSharedPointer<const Eigen::MatrixXd> &buffer, int xcol, int ycol,
+                       size_t rows);
+
+protected:
+  void attach();
+
+protected:
+  QSharedPointer<const Eigen::VectorXd> _x;
+  QSharedPointer<const Eigen::VectorXd> _y;
+  QSharedPointer<const Eigen::MatrixXd> _buffer;
+  const double *_xdata, *_ydata;
+  size_t _size;
+};
+
+
+class PointCloud: public QCPAbstractPlottable
+{
+  Q_OBJECT
+
+public:
+  PointCloud(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+  const PlotData &data() const;
+  void setData(const PlotData &data);
+  const QCPScatterStyle &scatterStyle() const;
+  void setScatterStyle(const QCPScatterStyle &style);
+
+  void clearData();
+  double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const;
+
+protected:
+  void draw(QCPPainter *painter);
+  void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
+  QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+  QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+  static QCPRange range(const PlotData::Column &values, bool &foundRange, SignDomain inSignDomain);
+
+protected:
+  PlotData _data;
+  QCPScatterStyle _scatterStyle;
+};
+
+#endif // PLOTDATA_HH
@@ -1,5 +1,16 @@
 #include "plotwindow.hh"
+#include "samplecache.hh"
+#include "densitycache.hh"
+#include "envelope.hh"
+#include "plotdata.hh"
 #include <Eigen/Eigen>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
 
 QVector<QColor> colors(
 { QColor(0, 0, 125), QColor(125, 0, 0), QColor(0, 125, 0), QColor(125, 125, 0), QColor(0, 125, 125),
@@ -9,21 +20,53 @@ QVector<QColor> colors(
   QColor(153, 61, 144), QColor(61, 121, 153), QColor(132, 61, 153), QColor(153, 78, 61),
   QColor(98, 153, 61), QColor(61, 151, 153), QColor(101, 61, 153), QColor(153, 61, 75) });
 
+// Delay (in ms) after the last range change before the visible interval gets re-evaluated
+static int refineDelay = 250;
+// Run tasks call into the library concurrently (read), the background re-evaluations of the plot
+// windows only while no task is running and one at a time (write). Re-evaluations never wait for
+// the lock, they are deferred instead.
+static QReadWriteLock evaluationLock;
+// Minimum time (in ms) between two updates of a plot while its samples are still being drawn
+static int progressiveUpdateInterval = 250;
+
+
+// Widens a degenerate sample range (e.g., a constant variable) to a non-empty interval around it
+static void
+binRange(double &min, double &max) {
+  if (max > min)
+    return;
+  double w = std::max(1.0, std::abs(min))/2;
+  min -= w; max += w;
+}
+
 
 /* ******************************************************************************************** *
  * Implementation of PlotWindow
  * ******************************************************************************************** */
 PlotWindow::PlotWindow(QWidget *parent)
-  : QMainWindow(parent), _plot(0)
+  : QMainWindow(parent), _plot(0), _stop(0), _envelope(0), _refineTimer(), _refinePending(false),
+    _refineMin(0), _refineMax(0), _refineDeferred(0), _refining()
 {
   _plot = new QCustomPlot(this);
   _plot->setInteraction(QCP::iRangeZoom, true);
   _plot->setInteraction(QCP::iRangeDrag, true);
   setCentralWidget(_plot);
+  _envelope = new EnvelopePlot(_plot);
 
   QToolBar *toolbar = new QToolBar();
   toolbar->addAction(tr("Save"), this, SLOT(onSave()));
+  _stop = toolbar->addAction(tr("Stop sampling"));
+  _stop->setVisible(false);
   this->addToolBar(toolbar);
+
+  _refineTimer.setSingleShot(true);
+  _refineTimer.setInterval(refineDelay);
+  connect(&_refineTimer, SIGNAL(timeout()), this, SLOT(onRefine()));
+  connect(&_refining, SIGNAL(finished()), this, SLOT(onRefined()));
+}
+
+PlotWindow::~PlotWindow() {
+  _refining.waitForFinished();
 }
 
 void
@@ -32,31 +75,147 @@ PlotWindow::onSave() {
                                                   tr("Image Format (*.png *.pdf)"));
   if (filename.isEmpty())
     return;
+  save(filename);
+}
+
+bool
+PlotWindow::save(const QString &filename) {
   QFileInfo info(filename);
   if ("png" == info.suffix())
-    _plot->savePng(filename);
+    return _plot->savePng(filename);
   else if ("pdf" == info.suffix())
-    _plot->savePdf(filename);
+    return _plot->savePdf(filename);
+  return false;
+}
+
+void
+PlotWindow::setSamplingTask(QObject *task) {
+  // While samples are drawn, the user may stop early and keep the plot of the samples so far
+  _stop->disconnect();
+  _stop->setVisible(0 != task);
+  if (task)
+    connect(_stop, SIGNAL(triggered()), task, SLOT(stop()));
+}
+
+bool
+PlotWindow::saveData(const QString &filename, const CSVWriter &writer) const {
+  if (0 == _plot->graphCount())
+    return false;
+
+  QFile file(filename);
+  if (! file.open(QIODevice::WriteOnly))
+    return false;
+
+  // All graphs are evaluated on the same grid, write one column per graph
+  QStringList names("t");
+  for (int i=0; i<_plot->graphCount(); i++)
+    names.append(_plot->graph(i)->name().isEmpty() ? QString::number(i+1) : _plot->graph(i)->name());
+
+  // Graphs backed by an envelope only show the visible part, write the complete series instead
+  if (_envelope->count() == _plot->graphCount()) {
+    Eigen::MatrixXd data(_envelope->series(0).size(), 1+_envelope->count());
+    data.col(0) = _envelope->series(0).data().x();
+    for (int i=0; i<_envelope->count(); i++)
+      data.col(i+1) = _envelope->series(i).data().y();
+    return writer.writeHeader(file, names) && writer.write(file, data);
+  }
+
+  Eigen::MatrixXd data(_plot->graph(0)->data()->size(), 1+_plot->graphCount());
+  QCPDataMap::const_iterator item = _plot->graph(0)->data()->constBegin();
+  for (int j=0; item != _plot->graph(0)->data()->constEnd(); item++, j++) {
+    data(j, 0) = item.key();
+    for (int i=0; i<_plot->graphCount(); i++)
+      data(j, i+1) = _plot->graph(i)->data()->value(item.key()).value;
+  }
+  return writer.writeHeader(file, names) && writer.write(file, data);
+}
+
+void
+PlotWindow::enableRefinement() {
+  connect(_plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(onRangeChanged(QCPRange)),
+          Qt::UniqueConnection);
+}
+
+void
+PlotWindow::onRangeChanged(const QCPRange &range) {
+  // Restart the timer, hence refinement starts once the user stopped zooming or dragging
+  _refineTimer.start();
+}
+
+void
+PlotWindow::onRefine() {
+  if (_refining.isRunning()) {
+    _refinePending = true;
+    return;
+  }
+  _refinePending = false;
+  // Evaluate at screen resolution, i.e., one point per pixel
+  _refineMin = _plot->xAxis->range().lower;
+  _refineMax = _plot->xAxis->range().upper;
+  size_t nstep = std::max(2, _plot->axisRect()->width());
+  _refining.setFuture(QtConcurrent::run(this, &PlotWindow::refine, _refineMin, _refineMax, nstep));
+}
+
+void
+PlotWindow::onRefined() {
+  QVector<Eigen::VectorXd> values = _refining.result();
+  if (_refinePending) {
+    onRefine();
+    return;
+  }
+  // Tasks are still running, try again later
+  if (_refineDeferred.fetchAndStoreOrdered(0)) {
+    _refineTimer.start();
+    return;
+  }
+  if (values.isEmpty() || (values.size() != _envelope->count()))
+    return;
+
+  // The envelope keeps the refined curves, hence they survive later zooming and panning
+  Eigen::VectorXd T(values.first().size());
+  double t = _refineMin, dt = (_refineMax-_refineMin)/T.size();
+  for (int j=0; j<T.size(); j++, t+=dt)
+    T(j) = t;
+  PlotData keys = PlotData::adopt(T, values[0]);
+  _envelope->setRefinement(0, keys);
+  for (int i=1; i<values.size(); i++)
+    _envelope->setRefinement(i, PlotData::adopt(keys, values[i]));
+  _plot->replot();
+}
+
+QVector<Eigen::VectorXd>
+PlotWindow::refine(double tmin, double tmax, size_t nstep) const {
+  QVector<Eigen::VectorXd> values;
+  if (! evaluationLock.tryLockForWrite()) {
+    _refineDeferred.store(1);
+    return values;
+  }
+  if (! evaluate(tmin, tmax, nstep, values))
+    values.clear();
+  evaluationLock.unlock();
+  return values;
+}
+
+bool
+PlotWindow::evaluate(double tmin, double tmax, size_t nstep, QVector<Eigen::VectorXd> &values) const {
+  return false;
 }
 
 
 /* ******************************************************************************************** *
  * Implementation of MarginalPlotWindow
  * ******************************************************************************************** */
-MarginalPlotWindow::MarginalPlotWindow(double tmin, double tmax, size_t nstep, const QVector<stochbb::Var> &vars, QWidget *parent)
-  : PlotWindow(parent), _tmin(tmin), _tmax(tmax), _nstep(nstep), _vars(vars)
+MarginalPlotWindow::MarginalPlotWindow(double tmin, double tmax, const QVector<stochbb::Var> &vars,
+                                       const QVector<PlotData> &densities, QWidget *parent)
+  : PlotWindow(parent), _tmin(tmin), _tmax(tmax), _nstep(0), _vars(vars)
 {
-  double t = _tmin, dt = (_tmax-_tmin)/_nstep;
-  Eigen::VectorXd F(_nstep), T(_nstep);
-  for (size_t i=0; i<_nstep; i++, t+=dt)
-    T(i) = t;
+  if (densities.size())
+    _nstep = densities.first().size();
   double ymax = 0;
-  for (size_t i=0; i<_vars.size(); i++) {
-    _vars[i].density().eval(tmin, tmax, F);
-    ymax = std::max(ymax, F.maxCoeff());
+  for (int i=0; i<densities.size(); i++) {
+    ymax = std::max(ymax, densities[i].y().maxCoeff());
     QCPGraph *graph = _plot->addGraph();
-    for (size_t j=0; j<nstep; j++)
-      graph->addData(T[j], F[j]);
+    _envelope->addSeries(graph, densities[i]);
     // Set pen color;
     QPen pen = graph->pen();
     pen.setColor(colors[i % colors.size()]);
@@ -71,76 +230,116 @@ MarginalPlotWindow::MarginalPlotWindow(double tmin, double tmax, size_t nstep, c
   _plot->xAxis->setRange(tmin, tmax);
   _plot->yAxis->setRange(0, ymax);
   _plot->replot();
+  enableRefinement();
+}
+
+MarginalPlotWindow::~MarginalPlotWindow() {
+  _refining.waitForFinished();
+}
+
+bool
+MarginalPlotWindow::evaluate(double tmin, double tmax, size_t nstep,
+                             QVector<Eigen::VectorXd> &values) const {
+  try {
+    for (int i=0; i<_vars.size(); i++) {
+      Eigen::VectorXd F(nstep);
+      _vars[i].density().eval(tmin, tmax, F);
+      values.append(F);
+    }
+  } catch (stochbb::Error &err) {
+    return false;
+  }
+  return true;
 }
 
 
 /* ******************************************************************************************** *
  * Implementation of ScatterPlotWindow
  * ******************************************************************************************** */
-ScatterPlotWindow::ScatterPlotWindow(size_t nsamples, const stochbb::Var &X, const stochbb::Var &Y, QWidget *parent)
-  : PlotWindow(parent), _samples(nsamples,2)
+ScatterPlotWindow::ScatterPlotWindow(const stochbb::Var &X, const stochbb::Var &Y, bool histogram,
+                                     size_t overlay, QWidget *parent)
+  : PlotWindow(parent), _samples(), _overlay(overlay), _map(0), _points(0)
 {
-  stochbb::ExactSampler sampler(X,Y);
-  sampler.sample(_samples);
-
   if (X.name().size())
     _plot->xAxis->setLabel(QString::fromStdString(X.name()));
   if (Y.name().size())
     _plot->yAxis->setLabel(QString::fromStdString(Y.name()));
 
-  QCPGraph *graph = _plot->addGraph();
-  graph->setScatterStyle(QCPScatterStyle::ssPlus);
-  graph->setLineStyle(QCPGraph::lsNone);
+  if (histogram) {
+    _map = new QCPColorMap(_plot->xAxis, _plot->yAxis);
+    _plot->addPlottable(_map);
+    _map->setGradient(QCPColorGradient::gpThermal);
+    _map->setInterpolate(false);
+    QCPColorScale *scale = new QCPColorScale(_plot);
+    _plot->plotLayout()->addElement(0, 1, scale);
+    _map->setColorScale(scale);
+  }
+
+  // The points are drawn straight from the sample buffers, on top of the histogram
+  _points = new PointCloud(_plot->xAxis, _plot->yAxis);
+  if (_map)
+    _points->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDot, Qt::white, 1));
+  _plot->addPlottable(_points);
+}
 
-  double xmin = _samples.col(0).minCoeff(), xmax = _samples.col(0).maxCoeff();
-  double ymin = _samples.col(1).minCoeff(), ymax = _samples.col(1).maxCoeff();
+void
+ScatterPlotWindow::setSamples(const PlotData &samples, const QCPRange &x, const QCPRange &y,
+                              const Eigen::MatrixXd &histogram) {
+  // The ranges and the histogram are computed by the task, hence updates do not touch the samples
+  _samples = samples;
+  if (0 == _samples.size()) {
+    _points->clearData();
+    _plot->replot();
+    return;
+  }
 
-  for (int i=0; i<_samples.rows(); i++) {
-    graph->addData(_samples(i, 0), _samples(i, 1));
+  if ((! _map) || (0 == histogram.size()))
+    _points->setData(_samples);
+  else {
+    // The histogram spans the given ranges, the color map however expects the range of the cell
+    // centers
+    double dx = x.size()/histogram.rows(), dy = y.size()/histogram.cols();
+    _map->data()->setSize(histogram.rows(), histogram.cols());
+    _map->data()->setRange(QCPRange(x.lower+dx/2, x.upper-dx/2), QCPRange(y.lower+dy/2, y.upper-dy/2));
+    for (int i=0; i<histogram.rows(); i++)
+      for (int j=0; j<histogram.cols(); j++)
+        _map->data()->setCell(i, j, histogram(i,j));
+    _map->rescaleDataRange(true);
+    // Samples are independent, hence the first rows already form a random subsample
+    _points->setData(_samples.head(_overlay));
   }
 
-  _plot->xAxis->setRange(xmin, xmax);
-  _plot->yAxis->setRange(ymin, ymax);
+  _plot->xAxis->setRange(x);
+  _plot->yAxis->setRange(y);
   _plot->replot();
 }
 
+bool
+ScatterPlotWindow::saveData(const QString &filename, const CSVWriter &writer) const {
+  QFile file(filename);
+  if (! file.open(QIODevice::WriteOnly))
+    return false;
+
+  QStringList names;
+  names << (_plot->xAxis->label().isEmpty() ? "X" : _plot->xAxis->label())
+        << (_plot->yAxis->label().isEmpty() ? "Y" : _plot->yAxis->label());
+  Eigen::MatrixXd data(_samples.size(), 2);
+  data.col(0) = _samples.x().head(_samples.size());
+  data.col(1) = _samples.y().head(_samples.size());
+  return writer.writeHeader(file, names) && writer.write(file, data);
+}
+
 
 /* ******************************************************************************************** *
  * Implementation of KDEPlotWindow
  * ******************************************************************************************** */
-KDEPlotWindow::KDEPlotWindow(size_t nsamples, const QVector<stochbb::Var> &vars, QWidget *parent)
-  : PlotWindow(parent), _nsamples(nsamples),  _vars(vars)
+KDEPlotWindow::KDEPlotWindow(const QVector<stochbb::Var> &vars, const QSharedPointer<SampleSet> &samples,
+                             QWidget *parent)
+  : PlotWindow(parent), _vars(vars), _samples(samples), _kdes()
 {
-  Eigen::MatrixXd samples(_nsamples, _vars.size());
-  stochbb::ExactSampler sampler(_vars.toStdVector());
-  sampler.sample(samples);
-
-  _densities.reserve(_vars.size());
-  for (int i=0; i<samples.cols(); i++) {
-    _densities.push_back(new KDE(samples.col(i)));
-  }
-
-  double min = _densities.first()->min();
-  double max = _densities.first()->max();
-  for (size_t i=1; i<_densities.size(); i++) {
-    min = std::min(min, _densities[i]->min());
-    max = std::max(max, _densities[i]->max());
-  }
-
-  size_t nstep = 200;
-  double t = min, dt = (max-min)/nstep;
-  Eigen::VectorXd F(nstep), T(nstep);
-  for (size_t i=0; i<nstep; i++, t+=dt)
-    T(i) = t;
-
-  double ymax = 0;
-  for (size_t i=0; i<_vars.size(); i++) {
+  for (int i=0; i<_vars.size(); i++) {
     QCPGraph *graph = _plot->addGraph();
-    for (size_t j=0; j<nstep; j++) {
-      double y = _densities[i]->eval(T[j]);
-      ymax = std::max(ymax, y);
-      graph->addData(T[j], y);
-    }
+    _envelope->addSeries(graph, PlotData());
     // Set pen color;
     QPen pen = graph->pen();
     pen.setColor(colors[i % colors.size()]);
@@ -151,74 +350,96 @@ KDEPlotWindow::KDEPlotWindow(size_t nsamples, const QVector<stochbb::Var> &vars,
     graph->addToLegend();
   }
   _plot->legend->setVisible(true);
-  _plot->xAxis->setRange(min, max);
-  _plot->yAxis->setRange(0, ymax);
-  _plot->replot();
-}
-
-KDEPlotWindow::~KDEPlotWindow() {
-  for (size_t i=0; i<_densities.size(); i++) {
-    delete _densities[i];
-  }
-  _densities.clear();
 }
 
+void
+KDEPlotWindow::setDensities(const QVector<PlotData> &densities, const QVector<KDE *> &kdes) {
+  // The window owns the KDEs, previous ones may still be in use by a refinement
+  _refining.waitForFinished();
+  qDeleteAll(_kdes);
+  _kdes = kdes;
 
-/* ******************************************************************************************** *
- * Implementation of KDE
- * ******************************************************************************************** */
-KDE::KDE(const Eigen::Ref<Eigen::VectorXd> &samples)
-  : _min(samples.minCoeff()), _max(samples.maxCoeff()), _bw(1), _samples(samples)
-{
-  double mu = _samples.mean();
-  double sigma2 = (_samples.array()*_samples.array()).mean() - mu*mu;
-  _bw = std::exp( std::log(1.06) + std::log(sigma2)/2 - std::log(_samples.size())/5 );
-  _min -= 3*_bw;
-  _max += 3*_bw;
-}
-
-double
-KDE::eval(double x) const {
-  double res = 0;
-  for (int i=0; i<_samples.size(); i++)
-    res += std::exp(-0.5*(x-_samples(i))*(x-_samples(i))/(2*_bw*_bw));
-  return res / (std::sqrt(2*M_PI)*_samples.size()*_bw);
+  double ymax = 0;
+  for (int i=0; (i<densities.size()) && (i<_envelope->count()); i++) {
+    _envelope->setSeries(i, densities[i]);
+    if (densities[i].size())
+      ymax = std::max(ymax, densities[i].y().maxCoeff());
+  }
+  if (densities.size() && densities.first().size()) {
+    PlotData::Column T = densities.first().x();
+    _plot->xAxis->setRange(T(0), T(T.size()-1));
+  }
+  _plot->yAxis->setRange(0, ymax);
+  _plot->replot();
+  if (_kdes.size() == _envelope->count())
+    enableRefinement();
 }
 
-double
-KDE::min() const {
-  return _min;
+KDEPlotWindow::~KDEPlotWindow() {
+  _refining.waitForFinished();
+  qDeleteAll(_kdes);
 }
 
-double
-KDE::max() const {
-  return _max;
+bool
+KDEPlotWindow::evaluate(double tmin, double tmax, size_t nstep, QVector<Eigen::VectorXd> &values) const {
+  Eigen::VectorXd T(nstep);
+  double t = tmin, dt = (tmax-tmin)/nstep;
+  for (size_t i=0; i<nstep; i++, t+=dt)
+    T(i) = t;
+  for (int i=0; i<_kdes.size(); i++) {
+    Eigen::VectorXd F;
+    _kdes[i]->eval(T, F);
+    values.append(F);
+  }
+  return true;
 }
 
 
 /* ******************************************************************************************** *
  * Implementation of SampleDumpWindow
  * ******************************************************************************************** */
-SampleDumpWindow::SampleDumpWindow(size_t nsamples, const QVector<stochbb::Var> &vars, QWidget *parent)
-  : QMainWindow(parent), _nsamples(nsamples),  _vars(vars)
+SampleDumpWindow::SampleDumpWindow(SampleDumpTask *task, size_t nsamples, size_t blocksize,
+                                   const QVector<stochbb::Var> &vars, QWidget *parent)
+  : QMainWindow(parent), _task(task), _nsamples(nsamples), _blocksize(std::max(size_t(1), blocksize)),
+    _vars(vars), _error(), _abort(0)
 {
   _filename = new QLineEdit();
   QPushButton *sel = new QPushButton("...");
-  QPushButton *save = new QPushButton("Sample & Save");
-  QHBoxLayout *layout = new QHBoxLayout();
-  layout->addWidget(_filename, 1);
-  layout->addWidget(sel, 0);
-  layout->addWidget(save, 0);
+  _save = new QPushButton("Sample & Save");
+  _progress = new QProgressBar();
+  _progress->setRange(0, 1000);
+  _progress->setValue(0);
+  _throughput = new QLabel();
+  QHBoxLayout *file = new QHBoxLayout();
+  file->addWidget(_filename, 1);
+  file->addWidget(sel, 0);
+  file->addWidget(_save, 0);
+  QHBoxLayout *status = new QHBoxLayout();
+  status->addWidget(_progress, 1);
+  status->addWidget(_throughput, 0);
+  QVBoxLayout *layout = new QVBoxLayout();
+  layout->addLayout(file);
+  layout->addLayout(status);
   QWidget *panel = new QWidget();
   panel->setLayout(layout);
   setCentralWidget(panel);
 
   connect(sel, SIGNAL(clicked(bool)), this, SLOT(onSelectFile()));
-  connect(save, SIGNAL(clicked(bool)), this, SLOT(onSave()));
+  connect(_save, SIGNAL(clicked(bool)), this, SLOT(onSave()));
+  connect(this, SIGNAL(progress(qint64)), this, SLOT(onProgress(qint64)));
+  connect(&_saving, SIGNAL(finished()), this, SLOT(onSaved()));
 }
 
 SampleDumpWindow::~SampleDumpWindow() {
-  // pass...
+  _abort.store(1);
+  _task->cancel();
+  _saving.waitForFinished();
+  delete _task;
+}
+
+const QString &
+SampleDumpWindow::error() const {
+  return _error;
 }
 
 void
@@ -229,35 +450,963 @@ SampleDumpWindow::onSave() {
   if (_filename->text().simplified().isEmpty()) {
     QMessageBox::critical(0, tr("Cannot save samples to file."),
                           tr("Cannot save samples: No file specified"));
+    return;
   }
 
-  Eigen::MatrixXd samples(_nsamples, _vars.size());
-  stochbb::ExactSampler sampler(_vars.toStdVector());
-  sampler.sample(samples);
+  // Sample and write in the background, the window shows the progress
+  _save->setEnabled(false);
+  _progress->setValue(0);
+  _throughput->clear();
+  _timer.start();
+  _saving.setFuture(QtConcurrent::run(this, &SampleDumpWindow::save, _filename->text(), CSVWriter()));
+}
 
-  QFile file(_filename->text());
-  if (! file.open(QIODevice::WriteOnly)) {
+void
+SampleDumpWindow::onSaved() {
+  _save->setEnabled(true);
+  if (! _saving.result()) {
     QMessageBox::critical(0, tr("Cannot save samples."),
-                          tr("Cannot save samples to %1: Cannot open file.").arg(file.fileName()));
-    return;
+                          tr("Cannot save samples to %1: %2").arg(_filename->text()).arg(_error));
   }
+}
+
+void
+SampleDumpWindow::onProgress(qint64 samples) {
+  _progress->setValue(int(1000*double(samples)/_nsamples));
+  double seconds = _timer.elapsed()/1000.;
+  if (seconds > 0)
+    _throughput->setText(tr("%1 samples/s").arg(samples/seconds, 0, 'g', 3));
+}
+
+// File formats of sample dumps, selected by the file suffix
+typedef enum {
+  DUMP_TEXT, DUMP_NPY, DUMP_FLOAT64, DUMP_FLOAT32
+} DumpFormat;
+
+static DumpFormat
+dumpFormat(const QString &filename) {
+  QString suffix = QFileInfo(filename).suffix().toLower();
+  if ("npy" == suffix)
+    return DUMP_NPY;
+  else if ("f64" == suffix)
+    return DUMP_FLOAT64;
+  else if ("f32" == suffix)
+    return DUMP_FLOAT32;
+  return DUMP_TEXT;
+}
+
+// Writes the header of a NPY (version 1.0) file holding a C-ordered float64 matrix. The header
+// is padded to at least the given size, such that it can be rewritten in place. Returns the size
+// of the header or -1 on error.
+static int
+writeNPYHeader(QFile &file, size_t rows, size_t cols, int size=0) {
+  QByteArray dict = QString("{'descr': '<f8', 'fortran_order': False, 'shape': (%1, %2), }")
+      .arg(rows).arg(cols).toLatin1();
+  // Magic, version and header length take 10 bytes, the data is aligned to 64 bytes
+  int len = std::max(dict.size() + 1, size - 10);
+  len += (64 - (10 + len) % 64) % 64;
+  dict = dict.leftJustified(len-1, ' ') + '\n';
+  QByteArray header("\x93NUMPY\x01\x00", 8);
+  header.append(char(len & 0xff)).append(char(len >> 8));
+  header.append(dict);
+  return (header.size() == file.write(header)) ? header.size() : -1;
+}
+
+// Writes the sidecar header of binary dumps, describing layout and column names
+static bool
+writeSidecar(const QString &filename, DumpFormat format, size_t rows, const QVector<stochbb::Var> &vars) {
+  QJsonArray names;
+  for (int i=0; i<vars.size(); i++)
+    names.append(vars[i].name().size() ? QString::fromStdString(vars[i].name()) : QString::number(i+1));
+  QJsonArray shape;
+  shape.append(double(rows)); shape.append(vars.size());
+  QJsonObject header;
+  header.insert("format", (DUMP_NPY == format) ? "npy" : "raw");
+  header.insert("dtype", (DUMP_FLOAT32 == format) ? "<f4" : "<f8");
+  header.insert("order", "C");
+  header.insert("shape", shape);
+  header.insert("columns", names);
+  QFile file(filename + ".json");
+  if (! file.open(QIODevice::WriteOnly))
+    return false;
+  QByteArray data = QJsonDocument(header).toJson();
+  return data.size() == file.write(data);
+}
+
+template <class Scalar>
+static bool
+writeBinaryBlock(QFile *file, const Eigen::MatrixXd *block) {
+  // Files are C-ordered little-endian, i.e. row by row
+  Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rows = block->cast<Scalar>();
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  for (int i=0; i<rows.size(); i++)
+    qToLittleEndian(rows.data()[i], (uchar *) (rows.data()+i));
+#endif
+  qint64 size = rows.size()*sizeof(Scalar);
+  return size == file->write((const char *) rows.data(), size);
+}
+
+// Writes one block of samples in the given format
+static bool
+writeSampleBlock(QFile *file, const Eigen::MatrixXd *block, DumpFormat format, CSVWriter writer) {
+  if (DUMP_FLOAT32 == format)
+    return writeBinaryBlock<float>(file, block);
+  else if (DUMP_TEXT != format)
+    return writeBinaryBlock<double>(file, block);
+  return writer.write(*file, *block);
+}
+
+bool
+SampleDumpWindow::save(const QString &filename, const CSVWriter &writer) {
+  _error.clear();
+  if (0 == _vars.size())
+    return false;
 
-  for (int i=0; i<samples.rows(); i++) {
-    file.write(QString::number(samples(i, 0)).toUtf8());
-    for (int j=1; j<samples.cols(); j++) {
-      file.write("\t"); file.write(QString::number(samples(i, j)).toUtf8());
+  QFile file(filename);
+  if (! file.open(QIODevice::WriteOnly)) {
+    _error = tr("Cannot open file.");
+    return false;
+  }
+  DumpFormat format = dumpFormat(filename);
+  int header = 0;
+  if ((DUMP_NPY == format) && (0 > (header = writeNPYHeader(file, _nsamples, _vars.size())))) {
+    _error = tr("Cannot write file.");
+    return false;
+  }
+
+  // Only two blocks are kept in memory: While one block is written, the next one is read from
+  // the samples of the run or drawn.
+  Eigen::MatrixXd blocks[2];
+  QFuture<bool> writing;
+  size_t offset = 0;
+  for (int i=0; (offset < _nsamples) && (! _abort.load()); i++) {
+    Eigen::MatrixXd &block = blocks[i % 2];
+    block.resize(std::min(_blocksize, _nsamples-offset), _vars.size());
+    if (! _task->read(offset, block)) {
+      _error = _task->error();
+      break;
     }
-    file.write("\n");
+    if (writing.isStarted() && (! writing.result()))
+      break;
+    writing = QtConcurrent::run(writeSampleBlock, &file, &block, format, writer);
+    offset += block.rows();
+    emit progress(offset);
+  }
+  // A failed write leaves the file in an unknown state, it is removed
+  if (writing.isStarted() && (! writing.result())) {
+    if (_error.isEmpty())
+      _error = tr("Cannot write file.");
+    file.remove();
+    return false;
+  }
+  // If stopped early, the headers describe the rows actually written
+  if ((offset < _nsamples) && (DUMP_NPY == format) &&
+      ((! file.seek(0)) || (0 > writeNPYHeader(file, offset, _vars.size(), header)))) {
+    if (_error.isEmpty())
+      _error = tr("Cannot write file.");
+    file.remove();
+    return false;
   }
   file.close();
+  if ((DUMP_TEXT != format) && (! writeSidecar(filename, format, offset, _vars)) && _error.isEmpty())
+    _error = tr("Cannot write header %1.json.").arg(filename);
+  return _error.isEmpty() && (! _abort.load());
 }
 
 void
 SampleDumpWindow::onSelectFile() {
   QString filename = QFileDialog::getSaveFileName(
         0, tr("Save samples as ..."),
-        "", tr("Comma separated values (*.csv *.txt)"));
+        "", tr("Comma separated values (*.csv *.txt);;NumPy array (*.npy);;"
+               "Raw float64, little-endian (*.f64);;Raw float32, little-endian (*.f32)"));
   if (filename.isEmpty())
     return;
   _filename->setText(filename);
 }
+
+
+/* ******************************************************************************************** *
+ * Implementation of SampleSet
+ * ******************************************************************************************** */
+SampleSet::SampleSet()
+  : _mutex(), _threads(1), _cacheKey(), _cacheDirectory(), _sampled(false), _nsamples(0), _rows(0),
+    _vars(), _sources(), _columns(), _samples(new Eigen::MatrixXd()), _densities(new DensitySet())
+{
+  // pass...
+}
+
+int
+SampleSet::add(Socket *source, const stochbb::Var &var, size_t nsamples) {
+  // All outputs share the same realisations, hence enough samples for the largest request are drawn
+  _nsamples = std::max(_nsamples, nsamples);
+  if (source && _columns.contains(source))
+    return _columns[source];
+  _vars.append(var);
+  _sources.append(source);
+  if (source)
+    _columns.insert(source, _vars.size()-1);
+  return _vars.size()-1;
+}
+
+const QVector<Socket *> &
+SampleSet::sources() const {
+  return _sources;
+}
+
+int
+SampleSet::threads() const {
+  return _threads;
+}
+
+void
+SampleSet::setThreads(int threads) {
+  _threads = std::max(1, threads);
+}
+
+void
+SampleSet::setCache(const QByteArray &key, const QString &directory) {
+  _cacheKey = key;
+  _cacheDirectory = directory;
+}
+
+bool
+SampleSet::sample(OutputTask *task, double from, double to) {
+  // The first task needing the samples draws them, all others wait for it
+  QMutexLocker lock(&_mutex);
+  if (_sampled || _vars.isEmpty())
+    return true;
+  _samples->resize(_nsamples, _vars.size());
+
+  // Take as many samples as possible from the cache and extend the cache by the missing ones.
+  // The missing samples are drawn in place, hence the rows reported by the task's sampled()
+  // signal can be read while sampling continues.
+  size_t cached = 0;
+  if (! _cacheKey.isEmpty())
+    cached = SampleCache(_cacheDirectory).load(_cacheKey, *_samples);
+  if (cached)
+    emit task->sampled(cached);
+  _rows = cached;
+  if (cached < _nsamples) {
+    size_t rows = 0;
+    if (! task->sample(_vars, _samples->bottomRows(_nsamples-cached), rows, from, to, _threads, cached))
+      return false;
+    // If the task was stopped early, only the first rows are valid
+    _rows = cached + rows;
+    // A cache that cannot be written is not an error
+    if (! _cacheKey.isEmpty())
+      SampleCache(_cacheDirectory).store(_cacheKey, _samples->topRows(_rows), cached);
+  }
+  _sampled = true;
+  return true;
+}
+
+bool
+SampleSet::read(OutputTask *task, size_t offset, Eigen::Ref<Eigen::MatrixXd> block) {
+  // Rows of the shared pass are taken from memory. Rows beyond it, requested by streamed
+  // outputs only, are taken from the cache or drawn and appended to the cache. Without a cache,
+  // these rows are drawn anew for every reader.
+  QMutexLocker lock(&_mutex);
+  size_t n = block.rows(), done = 0;
+  if (offset < _rows) {
+    done = std::min(n, _rows-offset);
+    block.topRows(done) = _samples->middleRows(offset, done);
+  }
+  if ((done < n) && (! _cacheKey.isEmpty()))
+    done += SampleCache(_cacheDirectory).load(_cacheKey, offset+done, block.bottomRows(n-done));
+  if (done < n) {
+    size_t rows = 0;
+    if (! task->sample(_vars, block.bottomRows(n-done), rows, 0, 0, _threads, offset+done))
+      return false;
+    if (rows < (n-done))
+      return false;
+    // A cache that cannot be written is not an error
+    if (! _cacheKey.isEmpty())
+      SampleCache(_cacheDirectory).append(_cacheKey, block.bottomRows(n-done), offset+done);
+  }
+  return true;
+}
+
+size_t
+SampleSet::rows() const {
+  return _rows;
+}
+
+int
+SampleSet::columns() const {
+  return _vars.size();
+}
+
+Eigen::MatrixXd &
+SampleSet::samples() {
+  return *_samples;
+}
+
+PlotData
+SampleSet::view(int xcol, int ycol, size_t rows) const {
+  // The buffer is allocated once before sampling, the view stays valid while rows get added
+  return PlotData::view(_samples, xcol, ycol, rows);
+}
+
+QSharedPointer<DensitySet>
+SampleSet::densities() const {
+  return _densities;
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of OutputTask
+ * ******************************************************************************************** */
+// Number of samples drawn at once, cancellation and progress are checked between chunks
+static const int sampleChunkSize = 10000;
+
+OutputTask::OutputTask(const QString &title, QObject *parent)
+  : QObject(parent), _title(title), _error(), _canceled(0), _stopped(0)
+{
+  // pass...
+}
+
+const QString &
+OutputTask::title() const {
+  return _title;
+}
+
+const QString &
+OutputTask::error() const {
+  return _error;
+}
+
+bool
+OutputTask::isCanceled() const {
+  return 0 != _canceled.load();
+}
+
+void
+OutputTask::cancel() {
+  _canceled.store(1);
+}
+
+bool
+OutputTask::isStopped() const {
+  return 0 != _stopped.load();
+}
+
+void
+OutputTask::stop() {
+  _stopped.store(1);
+}
+
+QMainWindow *
+OutputTask::createProgressWindow() {
+  return 0;
+}
+
+bool
+OutputTask::run() {
+  QReadLocker locker(&evaluationLock);
+  _error.clear();
+  try {
+    if (! compute())
+      return false;
+  } catch (stochbb::Error &err) {
+    _error = err.what();
+    return false;
+  }
+  setProgress(1);
+  return true;
+}
+
+void
+OutputTask::setProgress(double fraction) {
+  emit progress(int(1000*fraction));
+}
+
+bool
+OutputTask::sample(const QVector<stochbb::Var> &vars, Eigen::Ref<Eigen::MatrixXd> samples, size_t &rows,
+                   double from, double to, int threads, size_t offset) {
+  // The samples are split into fixed chunks independent of the number of threads. Chunks are
+  // handed out in order to the workers, each writing into its own rows of the sample matrix.
+  // Whenever the completed chunks at the front grow, their rows are announced by sampled(). The
+  // announcement is made outside of the lock, such that slow receivers do not stall the other
+  // workers. Hence, receivers may be called concurrently and out of order.
+  int nchunks = (samples.rows()+sampleChunkSize-1)/sampleChunkSize;
+  QVector<bool> finished(nchunks, false);
+  int complete = 0;
+  QAtomicInt next(0), done(0);
+  QMutex lock;
+  auto worker = [&]() {
+    try {
+      stochbb::ExactSampler sampler(vars.toStdVector());
+      Eigen::MatrixXd chunk;
+      int i;
+      while ((! isCanceled()) && (! isStopped()) && (nchunks > (i = next.fetchAndAddOrdered(1)))) {
+        int first = i*sampleChunkSize;
+        chunk.resize(std::min(sampleChunkSize, int(samples.rows())-first), samples.cols());
+        sampler.sample(chunk);
+        samples.block(first, 0, chunk.rows(), chunk.cols()) = chunk;
+        setProgress(from + (to-from)*double(done.fetchAndAddOrdered(1)+1)/nchunks);
+        QMutexLocker locker(&lock);
+        finished[i] = true;
+        if (i != complete)
+          continue;
+        while ((complete < nchunks) && finished[complete])
+          complete++;
+        size_t completed = std::min(size_t(complete)*sampleChunkSize, size_t(samples.rows()));
+        locker.unlock();
+        emit sampled(offset + completed);
+      }
+    } catch (stochbb::Error &err) {
+      QMutexLocker locker(&lock);
+      _error = err.what();
+      next.store(nchunks);
+    }
+  };
+
+  // The calling thread is one of the workers
+  QThreadPool pool;
+  pool.setMaxThreadCount(std::max(1, std::min(threads, nchunks)-1));
+  QList< QFuture<void> > workers;
+  for (int i=1; i<std::min(threads, nchunks); i++)
+    workers.append(QtConcurrent::run(&pool, worker));
+  worker();
+  foreach (QFuture<void> future, workers)
+    future.waitForFinished();
+
+  // If stopped, only the completed chunks at the front are kept
+  rows = std::min(size_t(complete)*sampleChunkSize, size_t(samples.rows()));
+  return _error.isEmpty() && (! isCanceled());
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of MarginalPlotTask
+ * ******************************************************************************************** */
+MarginalPlotTask::MarginalPlotTask(const QString &title, double tmin, double tmax, size_t nstep,
+                                   const QVector<stochbb::Var> &vars, const QVector<quint64> &keys,
+                                   int threads, QObject *parent)
+  : OutputTask(title, parent), _tmin(tmin), _tmax(tmax), _nstep(nstep), _vars(vars), _keys(keys),
+    _threads(threads), _cacheKeys(), _shared(), _densities()
+{
+  // pass...
+}
+
+void
+MarginalPlotTask::setCacheKeys(const QVector<QByteArray> &keys) {
+  _cacheKeys = keys;
+}
+
+void
+MarginalPlotTask::setDensitySet(const QSharedPointer<DensitySet> &shared) {
+  _shared = shared;
+}
+
+bool
+MarginalPlotTask::compute() {
+  // Densities of marginals with the same (non-zero) key are evaluated only once, others refer to
+  // the first marginal with that key. Keys are shared with all other marginal plots of the run,
+  // a grid claimed by another task is waited for once the own grids are evaluated. Grids
+  // evaluated in earlier runs are taken from the cache, all others are derived first.
+  QVector<Eigen::VectorXd> values;
+  QVector<int> marginal, source(_vars.size()), jobs, pending;
+  QVector<bool> claimed;
+  std::vector<stochbb::Density> densities;
+  QHash<quint64, int> first;
+  auto keyOf = [&](int j) -> quint64 {
+    return (marginal[j] < _keys.size()) ? _keys[marginal[j]] : 0;
+  };
+  // Claims not published (on error or cancellation) are left to other tasks
+  auto releaseClaims = [&]() {
+    for (int j=0; j<claimed.size(); j++) {
+      if (claimed[j])
+        _shared->release(keyOf(j), _tmin, _tmax, _nstep);
+    }
+  };
+  for (int i=0; i<_vars.size(); i++) {
+    quint64 key = (i < _keys.size()) ? _keys[i] : 0;
+    if (key && first.contains(key)) {
+      source[i] = first[key];
+      continue;
+    }
+    source[i] = values.size();
+    if (key)
+      first.insert(key, values.size());
+    values.append(Eigen::VectorXd(_nstep));
+    marginal.append(i);
+    claimed.append(false);
+    if (key && _shared) {
+      DensitySet::State state = _shared->claim(key, _tmin, _tmax, values.last());
+      if (DensitySet::AVAILABLE == state)
+        continue;
+      if (DensitySet::PENDING == state) {
+        pending.append(values.size()-1);
+        continue;
+      }
+      claimed.last() = true;
+    }
+    if ((i < _cacheKeys.size()) &&
+        DensityCache::instance().lookup(_cacheKeys[i], _tmin, _tmax, values.last())) {
+      if (claimed.last())
+        _shared->publish(key, _tmin, _tmax, values.last());
+      claimed.last() = false;
+      continue;
+    }
+    try {
+      densities.push_back(_vars[i].density());
+    } catch (stochbb::Error &err) {
+      _error = tr("Cannot derive density for marginal %0 (slot %1): %2")
+          .arg(_vars[i].name().c_str()).arg(i+1).arg(err.what());
+      releaseClaims();
+      return false;
+    }
+    jobs.append(values.size()-1);
+  }
+
+  // Evaluate the derived densities concurrently, the calling thread is one of the workers
+  QAtomicInt next(0), done(0);
+  QMutex lock;
+  auto worker = [&]() {
+    int j;
+    while ((! isCanceled()) && (jobs.size() > (j = next.fetchAndAddOrdered(1)))) {
+      int i = marginal[jobs[j]];
+      try {
+        densities[j].eval(_tmin, _tmax, values[jobs[j]]);
+        if (i < _cacheKeys.size())
+          DensityCache::instance().insert(_cacheKeys[i], _tmin, _tmax, values[jobs[j]]);
+        if (claimed[jobs[j]]) {
+          _shared->publish(keyOf(jobs[j]), _tmin, _tmax, values[jobs[j]]);
+          claimed[jobs[j]] = false;
+        }
+      } catch (stochbb::Error &err) {
+        QMutexLocker locker(&lock);
+        _error = tr("Cannot evaluate density for marginal %0 (slot %1): %2")
+            .arg(_vars[i].name().c_str()).arg(i+1).arg(err.what());
+        next.store(jobs.size());
+      }
+      setProgress(double(done.fetchAndAddOrdered(1)+1)/(jobs.size()+pending.size()));
+    }
+  };
+  int threads = std::min(_threads, jobs.size());
+  QThreadPool pool;
+  pool.setMaxThreadCount(std::max(1, threads-1));
+  QList< QFuture<void> > workers;
+  for (int i=1; i<threads; i++)
+    workers.append(QtConcurrent::run(&pool, worker));
+  worker();
+  foreach (QFuture<void> future, workers)
+    future.waitForFinished();
+  releaseClaims();
+  if ((! _error.isEmpty()) || isCanceled())
+    return false;
+
+  // Wait for grids claimed by other tasks, if one gets released, evaluate it here
+  foreach (int j, pending) {
+    if (isCanceled())
+      return false;
+    int i = marginal[j];
+    if (! _shared->wait(keyOf(j), _tmin, _tmax, values[j])) {
+      try {
+        _vars[i].density().eval(_tmin, _tmax, values[j]);
+      } catch (stochbb::Error &err) {
+        _error = tr("Cannot evaluate density for marginal %0 (slot %1): %2")
+            .arg(_vars[i].name().c_str()).arg(i+1).arg(err.what());
+        return false;
+      }
+      if (i < _cacheKeys.size())
+        DensityCache::instance().insert(_cacheKeys[i], _tmin, _tmax, values[j]);
+    }
+    setProgress(double(done.fetchAndAddOrdered(1)+1)/(jobs.size()+pending.size()));
+  }
+
+  _densities.clear();
+  for (int i=0; i<_vars.size(); i++)
+    _densities.append(values[source[i]]);
+  return true;
+}
+
+QMainWindow *
+MarginalPlotTask::createWindow() {
+  // The window adopts the evaluated densities and shares the grid among them
+  Eigen::VectorXd T(_nstep);
+  double t = _tmin, dt = (_tmax-_tmin)/_nstep;
+  for (size_t i=0; i<_nstep; i++, t+=dt)
+    T(i) = t;
+  QVector<PlotData> densities;
+  for (int i=0; i<_densities.size(); i++) {
+    if (0 == i)
+      densities.append(PlotData::adopt(T, _densities[i]));
+    else
+      densities.append(PlotData::adopt(densities.first(), _densities[i]));
+  }
+  MarginalPlotWindow *plot = new MarginalPlotWindow(_tmin, _tmax, _vars, densities);
+  plot->resize(480, 320);
+  plot->setWindowTitle(_title);
+  return plot;
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of ScatterPlotTask
+ * ******************************************************************************************** */
+ScatterPlotTask::ScatterPlotTask(const QString &title, const QSharedPointer<SampleSet> &samples,
+                                 size_t nsamples, const stochbb::Var &X, int xcol,
+                                 const stochbb::Var &Y, int ycol, int bins, size_t overlay,
+                                 QObject *parent)
+  : OutputTask(title, parent), _samples(samples), _nsamples(nsamples), _X(X), _xcol(xcol),
+    _Y(Y), _ycol(ycol), _bins(bins), _overlay(overlay), _window(), _binLock(), _updated(),
+    _binned(0), _xrange(), _yrange(), _histogram(), _pendingLock(), _pendingRows(0), _pendingX(),
+    _pendingY(), _pendingHistogram()
+{
+  // pass...
+}
+
+ScatterPlotTask::~ScatterPlotTask() {
+  // The progress window is only handed over once the task finished. If the run was canceled or
+  // failed, the partial plot is discarded with the task, "Stop sampling" keeps it instead.
+  if (_window)
+    delete _window;
+}
+
+// Adds the given samples to the histogram covering the given ranges
+static void
+accumulate2D(const Eigen::Ref<const Eigen::VectorXd> &x, const Eigen::Ref<const Eigen::VectorXd> &y,
+             const QCPRange &xrange, const QCPRange &yrange, Eigen::MatrixXd &histogram) {
+  int xbins = histogram.rows(), ybins = histogram.cols();
+  double sx = xbins/xrange.size(), sy = ybins/yrange.size();
+
+  // Each block gets its own histogram, they are summed up afterwards
+  size_t n = x.size();
+  int nblocks = std::max(1, QThread::idealThreadCount());
+  size_t blocksize = (n+nblocks-1)/nblocks;
+  QVector<Eigen::MatrixXd> partial(nblocks);
+  QVector<int> blocks(nblocks);
+  for (int b=0; b<nblocks; b++)
+    blocks[b] = b;
+  QtConcurrent::blockingMap(blocks, [&](int b) {
+    Eigen::MatrixXd &hist = partial[b];
+    hist.setZero(xbins, ybins);
+    size_t end = std::min(n, (b+1)*blocksize);
+    for (size_t k=b*blocksize; k<end; k++) {
+      int i = std::max(0, std::min(xbins-1, int((x(k)-xrange.lower)*sx)));
+      int j = std::max(0, std::min(ybins-1, int((y(k)-yrange.lower)*sy)));
+      hist(i,j) += 1;
+    }
+  });
+
+  for (int b=0; b<nblocks; b++)
+    histogram += partial[b];
+}
+
+bool
+ScatterPlotTask::compute() {
+  if (! _samples->sample(this, 0, 1))
+    return false;
+
+  // The final histogram spans the bounding box of the samples. It is binned here, hence the
+  // window only receives the finished grid.
+  size_t n = std::min(_nsamples, _samples->rows());
+  if (0 == n)
+    return true;
+  PlotData samples = _samples->view(_xcol, _ycol, n);
+  double xmin = samples.x().minCoeff(), xmax = samples.x().maxCoeff();
+  double ymin = samples.y().minCoeff(), ymax = samples.y().maxCoeff();
+  binRange(xmin, xmax);
+  binRange(ymin, ymax);
+  _xrange = QCPRange(xmin, xmax);
+  _yrange = QCPRange(ymin, ymax);
+  _histogram = Eigen::MatrixXd();
+  if (_bins > 0) {
+    _histogram.setZero(_bins, _bins);
+    accumulate2D(samples.x(), samples.y(), _xrange, _yrange, _histogram);
+  }
+  return ! isCanceled();
+}
+
+QMainWindow *
+ScatterPlotTask::createProgressWindow() {
+  _window = new ScatterPlotWindow(_X, _Y, _bins > 0, _overlay);
+  _window->resize(480, 320);
+  _window->setWindowTitle(_title);
+  _window->setSamplingTask(this);
+  // The new rows are binned by the sampling thread that announces them
+  connect(this, SIGNAL(sampled(qint64)), this, SLOT(onSampled(qint64)), Qt::DirectConnection);
+  return _window;
+}
+
+void
+ScatterPlotTask::onSampled(qint64 rows) {
+  // Sampling threads announce their rows concurrently. If another one is binning already, it is
+  // not waited for, a later announcement covers these rows as well.
+  if (! _binLock.tryLock())
+    return;
+  bin(std::min(_nsamples, size_t(rows)));
+  _binLock.unlock();
+}
+
+void
+ScatterPlotTask::bin(size_t n) {
+  // The final plot is drawn once the task finished
+  if ((n <= _binned) || (n >= _nsamples))
+    return;
+
+  // Only the new rows are binned. If they leave the current ranges, the ranges grow by a quarter
+  // to either side and all rows so far are binned anew.
+  PlotData samples = _samples->view(_xcol, _ycol, n);
+  Eigen::Ref<const Eigen::VectorXd> x = samples.x().tail(n-_binned), y = samples.y().tail(n-_binned);
+  if (_binned && (x.minCoeff() >= _xrange.lower) && (x.maxCoeff() <= _xrange.upper) &&
+      (y.minCoeff() >= _yrange.lower) && (y.maxCoeff() <= _yrange.upper)) {
+    if (_bins > 0)
+      accumulate2D(x, y, _xrange, _yrange, _histogram);
+  } else {
+    double xmin = samples.x().minCoeff(), xmax = samples.x().maxCoeff();
+    double ymin = samples.y().minCoeff(), ymax = samples.y().maxCoeff();
+    binRange(xmin, xmax);
+    binRange(ymin, ymax);
+    double dx = (xmax-xmin)/4, dy = (ymax-ymin)/4;
+    _xrange = QCPRange(xmin-dx, xmax+dx);
+    _yrange = QCPRange(ymin-dy, ymax+dy);
+    if (_bins > 0) {
+      _histogram.setZero(_bins, _bins);
+      accumulate2D(samples.x(), samples.y(), _xrange, _yrange, _histogram);
+    }
+  }
+  _binned = n;
+
+  if (_updated.isValid() && (_updated.elapsed() < progressiveUpdateInterval))
+    return;
+  _updated.start();
+  QMutexLocker locker(&_pendingLock);
+  _pendingRows = n;
+  _pendingX = _xrange; _pendingY = _yrange;
+  _pendingHistogram = _histogram;
+  QMetaObject::invokeMethod(this, "onUpdate", Qt::QueuedConnection);
+}
+
+void
+ScatterPlotTask::onUpdate() {
+  QMutexLocker locker(&_pendingLock);
+  size_t rows = _pendingRows;
+  QCPRange x = _pendingX, y = _pendingY;
+  Eigen::MatrixXd histogram;
+  histogram.swap(_pendingHistogram);
+  _pendingRows = 0;
+  locker.unlock();
+  if (_window && rows)
+    _window->setSamples(_samples->view(_xcol, _ycol, rows), x, y, histogram);
+}
+
+QMainWindow *
+ScatterPlotTask::createWindow() {
+  // Reuse the window that showed the progress, if any
+  ScatterPlotWindow *plot = _window;
+  _window = 0;
+  if (! plot) {
+    plot = new ScatterPlotWindow(_X, _Y, _bins > 0, _overlay);
+    plot->resize(480, 320);
+    plot->setWindowTitle(_title);
+  }
+  plot->setSamples(_samples->view(_xcol, _ycol, std::min(_nsamples, _samples->rows())),
+                   _xrange, _yrange, _histogram);
+  plot->setSamplingTask(0);
+  return plot;
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of KDEPlotTask
+ * ******************************************************************************************** */
+KDEPlotTask::KDEPlotTask(const QString &title, const QSharedPointer<SampleSet> &samples, size_t nsamples,
+                         const QVector<stochbb::Var> &vars, const QVector<int> &columns,
+                         KDE::Mode mode, QObject *parent)
+  : OutputTask(title, parent), _samples(samples), _nsamples(nsamples), _vars(vars), _columns(columns),
+    _mode(mode), _kdes(), _densities(), _window(), _binLock(), _updated(), _binned(0),
+    _counts(columns.size()), _pendingLock(), _pendingKDEs(), _pendingDensities()
+{
+  // pass...
+}
+
+KDEPlotTask::~KDEPlotTask() {
+  // The progress window is only handed over once the task finished. If the run was canceled or
+  // failed, the partial plot is discarded with the task, "Stop sampling" keeps it instead.
+  if (_window)
+    delete _window;
+  qDeleteAll(_kdes);
+  qDeleteAll(_pendingKDEs);
+}
+
+bool
+KDEPlotTask::compute() {
+  // Sampling takes the first half of the progress, evaluating the KDEs the second one
+  if (! _samples->sample(this, 0, 0.5))
+    return false;
+  qDeleteAll(_kdes);
+  _kdes.clear();
+  // The KDEs are kept, the plot window re-evaluates them when zoomed
+  size_t n = std::min(_nsamples, _samples->rows());
+  if (0 == n)
+    return true;
+  for (int i=0; i<_columns.size(); i++)
+    _kdes.push_back(new KDE(_samples->samples().col(_columns[i]).head(n), _mode));
+  return evaluate(_kdes, _densities, true);
+}
+
+bool
+KDEPlotTask::evaluate(const QVector<KDE *> &kdes, QVector<PlotData> &densities, bool report) {
+  if (kdes.isEmpty())
+    return true;
+
+  double min = kdes.first()->min();
+  double max = kdes.first()->max();
+  for (int i=1; i<kdes.size(); i++) {
+    min = std::min(min, kdes[i]->min());
+    max = std::max(max, kdes[i]->max());
+  }
+
+  size_t nstep = 200;
+  double t = min, dt = (max-min)/nstep;
+  Eigen::VectorXd T(nstep);
+  for (size_t i=0; i<nstep; i++, t+=dt)
+    T(i) = t;
+
+  // The densities adopt the evaluated values and share the grid among them
+  densities.clear();
+  for (int i=0; (i<kdes.size()) && (! isCanceled()); i++) {
+    Eigen::VectorXd F;
+    kdes[i]->eval(T, F);
+    if (0 == i)
+      densities.append(PlotData::adopt(T, F));
+    else
+      densities.append(PlotData::adopt(densities.first(), F));
+    if (report)
+      setProgress(0.5 + 0.5*double(i+1)/kdes.size());
+  }
+  return ! isCanceled();
+}
+
+QMainWindow *
+KDEPlotTask::createProgressWindow() {
+  _window = new KDEPlotWindow(_vars, _samples);
+  _window->resize(480, 320);
+  _window->setWindowTitle(_title);
+  _window->setSamplingTask(this);
+  // The new rows are binned by the sampling thread that announces them
+  connect(this, SIGNAL(sampled(qint64)), this, SLOT(onSampled(qint64)), Qt::DirectConnection);
+  return _window;
+}
+
+void
+KDEPlotTask::onSampled(qint64 rows) {
+  // Sampling threads announce their rows concurrently. If another one is binning already, it is
+  // not waited for, a later announcement covers these rows as well.
+  if (! _binLock.tryLock())
+    return;
+  bin(std::min(_nsamples, size_t(rows)));
+  _binLock.unlock();
+}
+
+void
+KDEPlotTask::bin(size_t n) {
+  // The final estimate is computed by the task itself
+  if ((n <= _binned) || (n >= _nsamples))
+    return;
+
+  // Only the new rows are added to the bins of the binned estimators. If they leave the grid, it
+  // grows and all rows so far are binned anew.
+  for (int i=0; i<_columns.size(); i++) {
+    Eigen::Ref<const Eigen::VectorXd> column = _samples->samples().col(_columns[i]).head(n);
+    Eigen::Ref<const Eigen::VectorXd> added = column.tail(n-_binned);
+    if (_counts[i].covers(added.minCoeff(), added.maxCoeff())) {
+      _counts[i].add(added);
+    } else {
+      _counts[i].reset(column.minCoeff(), column.maxCoeff());
+      _counts[i].add(column);
+    }
+  }
+  _binned = n;
+
+  if (_updated.isValid() && (_updated.elapsed() < progressiveUpdateInterval))
+    return;
+  _updated.start();
+  QVector<KDE *> kdes;
+  for (int i=0; i<_counts.size(); i++)
+    kdes.push_back(new KDE(_counts[i]));
+  QVector<PlotData> densities;
+  evaluate(kdes, densities, false);
+  QMutexLocker locker(&_pendingLock);
+  qDeleteAll(_pendingKDEs);
+  _pendingKDEs = kdes;
+  _pendingDensities = densities;
+  QMetaObject::invokeMethod(this, "onUpdate", Qt::QueuedConnection);
+}
+
+void
+KDEPlotTask::onUpdate() {
+  QMutexLocker locker(&_pendingLock);
+  QVector<KDE *> kdes = _pendingKDEs;
+  QVector<PlotData> densities = _pendingDensities;
+  _pendingKDEs.clear();
+  _pendingDensities.clear();
+  locker.unlock();
+  // The window takes ownership of the KDEs
+  if (_window && kdes.size())
+    _window->setDensities(densities, kdes);
+  else
+    qDeleteAll(kdes);
+}
+
+QMainWindow *
+KDEPlotTask::createWindow() {
+  // Reuse the window that showed the progress, if any. It takes ownership of the KDEs.
+  KDEPlotWindow *plot = _window;
+  _window = 0;
+  if (! plot) {
+    plot = new KDEPlotWindow(_vars, _samples);
+    plot->resize(480, 320);
+    plot->setWindowTitle(_title);
+  }
+  plot->setDensities(_densities, _kdes);
+  _kdes.clear();
+  plot->setSamplingTask(0);
+  return plot;
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of SampleDumpTask
+ * ******************************************************************************************** */
+SampleDumpTask::SampleDumpTask(const QString &title, const QSharedPointer<SampleSet> &samples,
+                               size_t nsamples, size_t blocksize, const QVector<stochbb::Var> &vars,
+                               const QVector<int> &columns, QObject *parent)
+  : OutputTask(title, parent), _samples(samples), _nsamples(nsamples), _blocksize(blocksize),
+    _vars(vars), _columns(columns)
+{
+  // pass...
+}
+
+bool
+SampleDumpTask::compute() {
+  // The dump itself is streamed once the user selected a file, but the first rows are shared
+  // with the other outputs of the run
+  return _samples->sample(this, 0, 1);
+}
+
+bool
+SampleDumpTask::read(size_t offset, Eigen::MatrixXd &block) {
+  // All variables of the run are read, such that the dump shares their realisations
+  QReadLocker locker(&evaluationLock);
+  _error.clear();
+  Eigen::MatrixXd joint(block.rows(), _samples->columns());
+  if (! _samples->read(this, offset, joint))
+    return false;
+  for (int j=0; j<_columns.size(); j++)
+    block.col(j) = joint.col(_columns[j]);
+  return true;
+}
+
+QMainWindow *
+SampleDumpTask::createWindow() {
+  // The window streams the samples later on, it gets its own task as this one is deleted once
+  // the run is done
+  SampleDumpTask *task = new SampleDumpTask(_title, _samples, _nsamples, _blocksize, _vars, _columns);
+  SampleDumpWindow *win = new SampleDumpWindow(task, _nsamples, _blocksize, _vars);
+  win->setWindowTitle(_title);
+  return win;
+}
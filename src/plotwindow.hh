@@ -2,8 +2,25 @@
 #define PLOTWINDOW_HH
 
 #include <QMainWindow>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QTimer>
 #include <stochbb/api.hh>
 #include "qcustomplot.hh"
+#include "csvwriter.hh"
+#include "kde.hh"
+#include "plotdata.hh"
+
+class Socket;
+class OutputTask;
+class SampleSet;
+class EnvelopePlot;
+class SampleDumpTask;
+class DensitySet;
 
 class PlotWindow: public QMainWindow
 {
@@ -11,12 +28,32 @@ class PlotWindow: public QMainWindow
 
 public:
   PlotWindow(QWidget *parent=0);
+  virtual ~PlotWindow();
+
+  bool save(const QString &filename);
+  virtual bool saveData(const QString &filename, const CSVWriter &writer=CSVWriter()) const;
+  void setSamplingTask(QObject *task);
 
 protected slots:
   void onSave();
+  void onRangeChanged(const QCPRange &range);
+  void onRefine();
+  void onRefined();
+
+protected:
+  void enableRefinement();
+  QVector<Eigen::VectorXd> refine(double tmin, double tmax, size_t nstep) const;
+  virtual bool evaluate(double tmin, double tmax, size_t nstep, QVector<Eigen::VectorXd> &values) const;
 
 protected:
   QCustomPlot *_plot;
+  QAction *_stop;
+  EnvelopePlot *_envelope;
+  QTimer _refineTimer;
+  bool _refinePending;
+  double _refineMin, _refineMax;
+  mutable QAtomicInt _refineDeferred;
+  QFutureWatcher< QVector<Eigen::VectorXd> > _refining;
 };
 
 
@@ -25,8 +62,12 @@ class MarginalPlotWindow: public PlotWindow
   Q_OBJECT
 
 public:
-  MarginalPlotWindow(double tmin, double tmax, size_t nstep, const QVector<stochbb::Var> &vars,
-                     QWidget *parent=0);
+  MarginalPlotWindow(double tmin, double tmax, const QVector<stochbb::Var> &vars,
+                     const QVector<PlotData> &densities, QWidget *parent=0);
+  virtual ~MarginalPlotWindow();
+
+protected:
+  bool evaluate(double tmin, double tmax, size_t nstep, QVector<Eigen::VectorXd> &values) const;
 
 protected:
   double _tmin;
@@ -41,62 +82,287 @@ class ScatterPlotWindow: public PlotWindow
   Q_OBJECT
 
 public:
-  ScatterPlotWindow(size_t nsamples, const stochbb::Var &X, const stochbb::Var &Y, QWidget *parent=0);
+  ScatterPlotWindow(const stochbb::Var &X, const stochbb::Var &Y, bool histogram=false, size_t overlay=0,
+                    QWidget *parent=0);
+
+  void setSamples(const PlotData &samples, const QCPRange &x, const QCPRange &y,
+                  const Eigen::MatrixXd &histogram=Eigen::MatrixXd());
+  bool saveData(const QString &filename, const CSVWriter &writer=CSVWriter()) const;
 
 protected:
-  Eigen::MatrixXd _samples;
+  PlotData _samples;
+  size_t _overlay;
+  QCPColorMap *_map;
+  PointCloud *_points;
 };
 
 
-class KDE
+class KDEPlotWindow: public PlotWindow
 {
+  Q_OBJECT
+
 public:
-  explicit KDE(const Eigen::Ref<Eigen::VectorXd> &samples);
+  KDEPlotWindow(const QVector<stochbb::Var> &vars,
+                const QSharedPointer<SampleSet> &samples=QSharedPointer<SampleSet>(), QWidget *parent=0);
+  virtual ~KDEPlotWindow();
+
+  void setDensities(const QVector<PlotData> &densities, const QVector<KDE *> &kdes=QVector<KDE *>());
 
-  double eval(double x) const;
-  double min() const;
-  double max() const;
+protected:
+  bool evaluate(double tmin, double tmax, size_t nstep, QVector<Eigen::VectorXd> &values) const;
 
 protected:
-  double _min, _max, _bw;
-  Eigen::Ref<Eigen::VectorXd> _samples;
+  QVector<stochbb::Var> _vars;
+  QSharedPointer<SampleSet> _samples;
+  QVector<KDE *> _kdes;
 };
 
 
-class KDEPlotWindow: public PlotWindow
+class SampleDumpWindow: public QMainWindow
 {
   Q_OBJECT
 
 public:
-  KDEPlotWindow(size_t nsamples, const QVector<stochbb::Var> &vars,
-                QWidget *parent=0);
-  virtual ~KDEPlotWindow();
+  SampleDumpWindow(SampleDumpTask *task, size_t nsamples, size_t blocksize,
+                   const QVector<stochbb::Var> &vars, QWidget *parent=0);
+  virtual ~SampleDumpWindow();
+
+  bool save(const QString &filename, const CSVWriter &writer=CSVWriter());
+  const QString &error() const;
+
+signals:
+  void progress(qint64 samples);
+
+protected slots:
+  void onSave();
+  void onSaved();
+  void onProgress(qint64 samples);
+  void onSelectFile();
 
 protected:
+  SampleDumpTask *_task;
   size_t _nsamples;
-  size_t _nbins;
+  size_t _blocksize;
   QVector<stochbb::Var> _vars;
-  QVector<KDE *> _densities;
+  QString _error;
+  QAtomicInt _abort;
+  QLineEdit *_filename;
+  QPushButton *_save;
+  QProgressBar *_progress;
+  QLabel *_throughput;
+  QElapsedTimer _timer;
+  QFutureWatcher<bool> _saving;
 };
 
 
-class SampleDumpWindow: public QMainWindow
+class SampleSet
+{
+public:
+  SampleSet();
+
+  int add(Socket *source, const stochbb::Var &var, size_t nsamples);
+  const QVector<Socket *> &sources() const;
+  int threads() const;
+  void setThreads(int threads);
+  void setCache(const QByteArray &key, const QString &directory);
+  bool sample(OutputTask *task, double from, double to);
+  bool read(OutputTask *task, size_t offset, Eigen::Ref<Eigen::MatrixXd> block);
+  size_t rows() const;
+  int columns() const;
+  Eigen::MatrixXd &samples();
+  PlotData view(int xcol, int ycol, size_t rows) const;
+  QSharedPointer<DensitySet> densities() const;
+
+protected:
+  QMutex _mutex;
+  int _threads;
+  QByteArray _cacheKey;
+  QString _cacheDirectory;
+  bool _sampled;
+  size_t _nsamples;
+  size_t _rows;
+  QVector<stochbb::Var> _vars;
+  QVector<Socket *> _sources;
+  QHash<Socket *, int> _columns;
+  QSharedPointer<Eigen::MatrixXd> _samples;
+  QSharedPointer<DensitySet> _densities;
+};
+
+
+class OutputTask: public QObject
 {
   Q_OBJECT
 
 public:
-  SampleDumpWindow(size_t nsamples, const QVector<stochbb::Var> &vars, QWidget *parent=0);
-  virtual ~SampleDumpWindow();
+  OutputTask(const QString &title, QObject *parent=0);
+
+  const QString &title() const;
+  const QString &error() const;
+  bool isCanceled() const;
+  bool isStopped() const;
+
+  bool run();
+  virtual QMainWindow *createProgressWindow();
+  virtual QMainWindow *createWindow() = 0;
+
+public slots:
+  void cancel();
+  void stop();
+
+signals:
+  void progress(int permille);
+  void sampled(qint64 rows);
+
+  friend class SampleSet;
+
+protected:
+  virtual bool compute() = 0;
+  void setProgress(double fraction);
+  bool sample(const QVector<stochbb::Var> &vars, Eigen::Ref<Eigen::MatrixXd> samples, size_t &rows,
+              double from, double to, int threads=1, size_t offset=0);
+
+protected:
+  QString _title;
+  QString _error;
+  QAtomicInt _canceled;
+  QAtomicInt _stopped;
+};
+
+
+class MarginalPlotTask: public OutputTask
+{
+  Q_OBJECT
+
+public:
+  MarginalPlotTask(const QString &title, double tmin, double tmax, size_t nstep,
+                   const QVector<stochbb::Var> &vars, const QVector<quint64> &keys=QVector<quint64>(),
+                   int threads=1, QObject *parent=0);
+
+  void setCacheKeys(const QVector<QByteArray> &keys);
+  void setDensitySet(const QSharedPointer<DensitySet> &shared);
+  QMainWindow *createWindow();
+
+protected:
+  bool compute();
+
+protected:
+  double _tmin;
+  double _tmax;
+  size_t _nstep;
+  QVector<stochbb::Var> _vars;
+  QVector<quint64> _keys;
+  int _threads;
+  QVector<QByteArray> _cacheKeys;
+  QSharedPointer<DensitySet> _shared;
+  QVector<Eigen::VectorXd> _densities;
+};
+
+
+class ScatterPlotTask: public OutputTask
+{
+  Q_OBJECT
+
+public:
+  ScatterPlotTask(const QString &title, const QSharedPointer<SampleSet> &samples, size_t nsamples,
+                  const stochbb::Var &X, int xcol, const stochbb::Var &Y, int ycol, int bins=0,
+                  size_t overlay=0, QObject *parent=0);
+  virtual ~ScatterPlotTask();
+
+  QMainWindow *createProgressWindow();
+  QMainWindow *createWindow();
 
 protected slots:
-  void onSave();
-  void onSelectFile();
+  void onSampled(qint64 rows);
+  void onUpdate();
+
+protected:
+  bool compute();
+  void bin(size_t n);
+
+protected:
+  QSharedPointer<SampleSet> _samples;
+  size_t _nsamples;
+  stochbb::Var _X;
+  int _xcol;
+  stochbb::Var _Y;
+  int _ycol;
+  int _bins;
+  size_t _overlay;
+  QPointer<ScatterPlotWindow> _window;
+  QMutex _binLock;
+  QElapsedTimer _updated;
+  size_t _binned;
+  QCPRange _xrange, _yrange;
+  Eigen::MatrixXd _histogram;
+  QMutex _pendingLock;
+  size_t _pendingRows;
+  QCPRange _pendingX, _pendingY;
+  Eigen::MatrixXd _pendingHistogram;
+};
+
+
+class KDEPlotTask: public OutputTask
+{
+  Q_OBJECT
+
+public:
+  KDEPlotTask(const QString &title, const QSharedPointer<SampleSet> &samples, size_t nsamples,
+              const QVector<stochbb::Var> &vars, const QVector<int> &columns,
+              KDE::Mode mode=KDE::AUTO, QObject *parent=0);
+  virtual ~KDEPlotTask();
+
+  QMainWindow *createProgressWindow();
+  QMainWindow *createWindow();
+
+protected slots:
+  void onSampled(qint64 rows);
+  void onUpdate();
+
+protected:
+  bool compute();
+  void bin(size_t n);
+  bool evaluate(const QVector<KDE *> &kdes, QVector<PlotData> &densities, bool report);
 
 protected:
+  QSharedPointer<SampleSet> _samples;
   size_t _nsamples;
-  size_t _nbins;
   QVector<stochbb::Var> _vars;
-  QLineEdit *_filename;
+  QVector<int> _columns;
+  KDE::Mode _mode;
+  QVector<KDE *> _kdes;
+  QVector<PlotData> _densities;
+  QPointer<KDEPlotWindow> _window;
+  QMutex _binLock;
+  QElapsedTimer _updated;
+  size_t _binned;
+  QVector<KDEBins> _counts;
+  QMutex _pendingLock;
+  QVector<KDE *> _pendingKDEs;
+  QVector<PlotData> _pendingDensities;
+};
+
+
+class SampleDumpTask: public OutputTask
+{
+  Q_OBJECT
+
+public:
+  SampleDumpTask(const QString &title, const QSharedPointer<SampleSet> &samples, size_t nsamples,
+                 size_t blocksize, const QVector<stochbb::Var> &vars, const QVector<int> &columns,
+                 QObject *parent=0);
+
+  bool read(size_t offset, Eigen::MatrixXd &block);
+  QMainWindow *createWindow();
+
+protected:
+  bool compute();
+
+protected:
+  QSharedPointer<SampleSet> _samples;
+  size_t _nsamples;
+  size_t _blocksize;
+  QVector<stochbb::Var> _vars;
+  QVector<int> _columns;
 };
 
 #endif // PLOTWINDOW_HH
@@ -445,6 +445,13 @@ void
 QNetView::remNode(QNetNode *node) {
   if (! _nodes.contains(node))
     return;
+  // Remove all edges connected to the node
+  QList<QNetSocket *> sockets = node->_leftSockets + node->_rightSockets;
+  foreach (QNetSocket *socket, sockets) {
+    QList<QNetEdge *> edges = _incoming.value(socket) + _outgoing.value(socket);
+    foreach (QNetEdge *edge, edges)
+      this->remEdge(edge);
+  }
   _nodes.removeAll(node);
   node->deleteLater();
   setModified();
@@ -454,10 +461,27 @@ QNetView::remNode(QNetNode *node) {
 void
 QNetView::clear() {
   bool mod = _nodes.size();
-  while (_nodes.size()) {
-    this->remNode(_nodes.first());
+  // Everything goes at once, hence the lists and indexes are dropped instead of removing the
+  // items one by one
+  foreach (QNetEdge *edge, _edges) {
+    disconnect(edge, 0, this, 0);
+    edge->deleteLater();
   }
+  foreach (QNetNode *node, _nodes) {
+    disconnect(node, 0, this, 0);
+    node->deleteLater();
+  }
+  _edges.clear();
+  _edgeIndex.clear();
+  _incoming.clear();
+  _outgoing.clear();
+  _nodes.clear();
+  _selectedNode = 0;
+  _selectedEdge = 0;
+  _dragging = 0;
+  _connecting = 0;
   setModified(mod);
+  updateLayout();
 }
 
 QNetView::nodeIterator
@@ -483,7 +507,9 @@ QNetView::addConnection(QNetSocket *a, QNetSocket *b) {
 void
 QNetView::addEdge(QNetEdge *edge) {
   edge->setParent(this);
+  _edgeIndex.insert(edge, _edges.size());
   _edges.append(edge);
+  indexEdge(edge);
   connect(edge, SIGNAL(destroyed(QObject*)), this, SLOT(itemDestroyed(QObject*)));
   setModified();
   updateLayout();
@@ -491,9 +517,9 @@ QNetView::addEdge(QNetEdge *edge) {
 
 void
 QNetView::remEdge(QNetEdge *edge) {
-  if (! _edges.contains(edge))
+  if (! takeEdge(edge))
     return;
-  _edges.removeAll(edge);
+  unindexEdge(edge);
   edge->deleteLater();
   setModified();
   updateLayout();
@@ -527,9 +553,8 @@ QNetView::selectedEdge() const {
 QList<QNetSocket *>
 QNetView::findSources(QNetSocket *dest) {
   QList<QNetSocket *> sockets;
-  foreach (QNetEdge *edge, _edges) {
-    if (edge->dest() == dest)
-      sockets.append(edge->src());
+  foreach (QNetEdge *edge, _incoming.value(dest)) {
+    sockets.append(edge->src());
   }
   return sockets;
 }
@@ -537,13 +562,17 @@ QNetView::findSources(QNetSocket *dest) {
 QList<QNetSocket *>
 QNetView::findDestinations(QNetSocket *src) {
   QList<QNetSocket *> sockets;
-  foreach (QNetEdge *edge, _edges) {
-    if (edge->src() == src)
-      sockets.append(edge->dest());
+  foreach (QNetEdge *edge, _outgoing.value(src)) {
+    sockets.append(edge->dest());
   }
   return sockets;
 }
 
+bool
+QNetView::hasSource(QNetSocket *dest) const {
+  return _incoming.contains(dest);
+}
+
 bool
 QNetView::isModified() const{
   return _modified;
@@ -575,14 +604,13 @@ QNetView::setModified(bool mod) {
 
 void
 QNetView::itemDestroyed(QObject *item) {
-  if (_nodes.contains((QNetNode *) item)) {
+  if (takeEdge((QNetEdge *) item)) {
+    if (_selectedEdge == (QNetEdge *) item)
+      _selectedEdge = 0;
+  } else if (_nodes.contains((QNetNode *) item)) {
     _nodes.removeAll((QNetNode *) item);
     if (_selectedNode == (QNetNode *) item)
       _selectedNode = 0;
-  } else if (_edges.contains((QNetEdge *) item)) {
-    _edges.removeAll((QNetEdge *) item);
-    if (_selectedEdge == (QNetEdge *) item)
-      _selectedEdge = 0;
   } else {
     return;
   }
@@ -590,6 +618,58 @@ QNetView::itemDestroyed(QObject *item) {
   updateLayout();
 }
 
+void
+QNetView::socketDestroyed(QObject *socket) {
+  // The edges connected to a destroyed socket will be deleted later,
+  // remove them from the index immediately.
+  QList<QNetEdge *> edges = _incoming.value((QNetSocket *) socket)
+      + _outgoing.value((QNetSocket *) socket);
+  foreach (QNetEdge *edge, edges)
+    unindexEdge(edge);
+}
+
+void
+QNetView::indexEdge(QNetEdge *edge) {
+  _outgoing[edge->src()].append(edge);
+  _incoming[edge->dest()].append(edge);
+  connect(edge->src(), SIGNAL(destroyed(QObject*)), this, SLOT(socketDestroyed(QObject*)),
+          Qt::UniqueConnection);
+  connect(edge->dest(), SIGNAL(destroyed(QObject*)), this, SLOT(socketDestroyed(QObject*)),
+          Qt::UniqueConnection);
+}
+
+bool
+QNetView::takeEdge(QNetEdge *edge) {
+  // The last edge takes the place of the removed one, hence removal does not scan the list
+  QHash<QNetEdge *, int>::iterator item = _edgeIndex.find(edge);
+  if (item == _edgeIndex.end())
+    return false;
+  int idx = item.value();
+  _edgeIndex.erase(item);
+  QNetEdge *last = _edges.takeLast();
+  if (last != edge) {
+    _edges[idx] = last;
+    _edgeIndex[last] = idx;
+  }
+  return true;
+}
+
+void
+QNetView::unindexEdge(QNetEdge *edge) {
+  QHash<QNetSocket *, QList<QNetEdge *> >::iterator item = _outgoing.find(edge->src());
+  if (item != _outgoing.end()) {
+    item->removeAll(edge);
+    if (item->isEmpty())
+      _outgoing.erase(item);
+  }
+  item = _incoming.find(edge->dest());
+  if (item != _incoming.end()) {
+    item->removeAll(edge);
+    if (item->isEmpty())
+      _incoming.erase(item);
+  }
+}
+
 
 void
 QNetView::updateLayout() {
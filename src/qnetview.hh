@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QSet>
 #include <QList>
+#include <QHash>
 #include <QFont>
 #include <QPen>
 #include <QBrush>
@@ -183,6 +184,7 @@ public:
 
   QList<QNetSocket *> findSources(QNetSocket *dest);
   QList<QNetSocket *> findDestinations(QNetSocket *src);
+  bool hasSource(QNetSocket *dest) const;
 
   bool isModified() const;
 
@@ -201,9 +203,13 @@ signals:
 
 protected slots:
   void itemDestroyed(QObject *item);
+  void socketDestroyed(QObject *socket);
 
 protected:
   void updateLayout();
+  void indexEdge(QNetEdge *edge);
+  void unindexEdge(QNetEdge *edge);
+  bool takeEdge(QNetEdge *edge);
 
   void paintEvent(QPaintEvent *evt);
   void mousePressEvent(QMouseEvent *evt);
@@ -215,6 +221,9 @@ protected:
   double _scale;
   QList<QNetNode*> _nodes;
   QList<QNetEdge*> _edges;
+  QHash<QNetEdge *, int> _edgeIndex;
+  QHash<QNetSocket *, QList<QNetEdge *> > _incoming;
+  QHash<QNetSocket *, QList<QNetEdge *> > _outgoing;
   bool _modified;
 
   QNetNode *_dragging;
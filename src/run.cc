@@ -0,0 +1,196 @@
+#include <stochbb/api.hh>
+
+#include "network.hh"
+#include "nodes.hh"
+#include "assembler.hh"
+#include "plotwindow.hh"
+
+#include <iostream>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QThreadPool>
+
+
+// Exit codes: success, invalid arguments, network cannot be loaded, network cannot be
+// assembled and at least one output node failed.
+typedef enum {
+  RUN_OK = 0, RUN_USAGE, RUN_LOAD, RUN_ASSEMBLE, RUN_EXECUTE
+} ExitCode;
+
+
+static QString
+uniqueName(const QString &label, QSet<QString> &names) {
+  QString name = label.simplified();
+  name.replace(QRegExp("[^A-Za-z0-9_.-]+"), "_");
+  if (name.isEmpty())
+    name = "output";
+  QString unique = name;
+  for (int i=2; names.contains(unique); i++)
+    unique = QString("%1_%2").arg(name).arg(i);
+  names.insert(unique);
+  return unique;
+}
+
+
+int main(int argc, char *argv[]) {
+  // Render plots without a display unless a platform is specified explicitly
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QApplication app(argc, argv);
+  app.setApplicationName("stochbb-run");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Executes all output nodes of a StochBB network without a GUI.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("network", "The network XML file to run.");
+  QCommandLineOption outdir(QStringList() << "o" << "output",
+                            "Directory to store the results in.", "directory", ".");
+  QCommandLineOption format(QStringList() << "f" << "format",
+                            "Image format of the plots, either 'png', 'pdf' or 'none'.", "format", "png");
+  QCommandLineOption dumpFormat(QStringList() << "d" << "dump-format",
+                                "File format of sample dumps, either 'csv', 'npy', 'f64' or 'f32'.",
+                                "format", "csv");
+  QCommandLineOption delimiter(QStringList() << "delimiter",
+                               "Column delimiter of text files, either 'tab' or a single character.",
+                               "delimiter", "tab");
+  QCommandLineOption precision(QStringList() << "precision",
+                               "Significant digits of values in text files, 0 for the shortest exact representation.",
+                               "digits", "0");
+  QCommandLineOption jobs(QStringList() << "j" << "jobs",
+                          "Number of threads used for sampling and density evaluation.", "threads", "1");
+  parser.addOption(outdir);
+  parser.addOption(format);
+  parser.addOption(dumpFormat);
+  parser.addOption(delimiter);
+  parser.addOption(precision);
+  QCommandLineOption cache(QStringList() << "c" << "cache",
+                           "Directory to cache samples in, samples are not cached if unset. The seed "
+                           "is not part of the cache key, hence cached runs replay the same realisations.",
+                           "directory");
+  parser.addOption(jobs);
+  parser.addOption(cache);
+  parser.process(app);
+
+  if (1 != parser.positionalArguments().size()) {
+    std::cerr << "Expected exactly one network file." << std::endl;
+    return RUN_USAGE;
+  }
+  QString imgFormat = parser.value(format).toLower();
+  if (("png" != imgFormat) && ("pdf" != imgFormat) && ("none" != imgFormat)) {
+    std::cerr << "Unknown image format '" << imgFormat.toStdString() << "'." << std::endl;
+    return RUN_USAGE;
+  }
+  QString dumpSuffix = parser.value(dumpFormat).toLower();
+  if (! (QStringList() << "csv" << "npy" << "f64" << "f32").contains(dumpSuffix)) {
+    std::cerr << "Unknown sample dump format '" << dumpSuffix.toStdString() << "'." << std::endl;
+    return RUN_USAGE;
+  }
+  QString delim = parser.value(delimiter);
+  if ("tab" == delim)
+    delim = "\t";
+  if (1 != delim.toLatin1().size()) {
+    std::cerr << "Invalid delimiter '" << delim.toStdString() << "'." << std::endl;
+    return RUN_USAGE;
+  }
+  bool ok;
+  int digits = parser.value(precision).toInt(&ok);
+  if ((! ok) || (0 > digits)) {
+    std::cerr << "Invalid precision '" << parser.value(precision).toStdString() << "'." << std::endl;
+    return RUN_USAGE;
+  }
+  CSVWriter writer(delim.toLatin1()[0], digits);
+  int threads = parser.value(jobs).toInt(&ok);
+  if ((! ok) || (1 > threads)) {
+    std::cerr << "Invalid number of threads '" << parser.value(jobs).toStdString() << "'." << std::endl;
+    return RUN_USAGE;
+  }
+  // Densities and KDEs are evaluated on the global pool, it is bound by the same limit
+  QThreadPool::globalInstance()->setMaxThreadCount(threads);
+  QDir dir(parser.value(outdir));
+  if ((! dir.exists()) && (! dir.mkpath("."))) {
+    std::cerr << "Cannot create output directory " << dir.path().toStdString() << "." << std::endl;
+    return RUN_USAGE;
+  }
+
+  // Load network
+  QString filename = parser.positionalArguments().first();
+  Network network;
+  ParserInfo info;
+  if (! network.load(filename, info)) {
+    std::cerr << "Cannot load network from " << filename.toStdString() << ":" << std::endl;
+    foreach (QString msg, info.messages())
+      std::cerr << " " << msg.toStdString() << std::endl;
+    return RUN_LOAD;
+  }
+  foreach (QString msg, info.messages())
+    std::cerr << msg.toStdString() << std::endl;
+
+  // Assemble network
+  Messages messages;
+  bool assembled = network.assemble(messages);
+  foreach (Message msg, messages)
+    std::cerr << msg.text().toStdString() << std::endl;
+  if (! assembled)
+    return RUN_ASSEMBLE;
+
+  // Collect all output nodes first, such that sample-based outputs share a single sampling pass
+  const QHash<Socket *, stochbb::Var> &varTable = network.variables();
+  QSharedPointer<SampleSet> samples(new SampleSet());
+  samples->setThreads(threads);
+  QList<OutputTask *> tasks;
+  Network::nodeIterator node = network.nodesBegin();
+  for (; node != network.nodesEnd(); node++) {
+    if (OutputNode *out = dynamic_cast<OutputNode *>(*node)) {
+      if (OutputTask *task = out->createTask(varTable, samples))
+        tasks.append(task);
+    }
+  }
+  if (parser.isSet(cache))
+    samples->setCache(network.samplingKey(samples->sources()), parser.value(cache));
+
+  // Execute all output nodes into files
+  QSet<QString> names;
+  int res = RUN_OK;
+  foreach (OutputTask *task, tasks) {
+    QString base = dir.filePath(uniqueName(task->title(), names));
+    if (! task->run()) {
+      std::cerr << "Cannot execute " << task->title().toStdString() << ": "
+                << task->error().toStdString() << std::endl;
+      res = RUN_EXECUTE;
+      delete task;
+      continue;
+    }
+
+    QMainWindow *win = task->createWindow();
+    if (! win) {
+      std::cerr << "Cannot execute " << task->title().toStdString() << ": "
+                << task->error().toStdString() << std::endl;
+      res = RUN_EXECUTE;
+      delete task;
+      continue;
+    }
+    QStringList failed;
+    if (PlotWindow *plot = dynamic_cast<PlotWindow *>(win)) {
+      if (! plot->saveData(base + ".csv", writer))
+        failed.append(base + ".csv");
+      if (("none" != imgFormat) && (! plot->save(base + "." + imgFormat)))
+        failed.append(base + "." + imgFormat);
+    } else if (SampleDumpWindow *dump = dynamic_cast<SampleDumpWindow *>(win)) {
+      if (! dump->save(base + "." + dumpSuffix, writer))
+        failed.append(base + "." + dumpSuffix + ": " + dump->error());
+    }
+    foreach (QString file, failed) {
+      std::cerr << "Cannot write " << file.toStdString() << "." << std::endl;
+      res = RUN_EXECUTE;
+    }
+    delete win;
+    delete task;
+  }
+
+  return res;
+}
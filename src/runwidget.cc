@@ -0,0 +1,102 @@
+#include "runwidget.hh"
+#include "plotwindow.hh"
+#include <QtConcurrent>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QMessageBox>
+
+
+RunWidget::RunWidget(QWidget *parent)
+  : QWidget(parent), _pool(), _tasks(), _items()
+{
+  // It is not known whether libstochbb may be used from several threads at once, hence tasks
+  // are executed one after another, but off the GUI thread.
+  _pool.setMaxThreadCount(1);
+
+  _rows = new QVBoxLayout();
+  _rows->setMargin(0);
+  _cancel = new QPushButton(tr("Cancel"));
+  connect(_cancel, SIGNAL(clicked()), this, SLOT(cancel()));
+
+  QHBoxLayout *layout = new QHBoxLayout();
+  layout->addLayout(_rows, 1);
+  layout->addWidget(_cancel, 0, Qt::AlignTop);
+  setLayout(layout);
+  setVisible(false);
+}
+
+RunWidget::~RunWidget() {
+  cancel();
+  _pool.waitForDone();
+  qDeleteAll(_tasks.values());
+}
+
+bool
+RunWidget::isRunning() const {
+  return ! _tasks.isEmpty();
+}
+
+void
+RunWidget::start(const QList<OutputTask *> &tasks) {
+  foreach (OutputTask *task, tasks) {
+    QWidget *item = new QWidget();
+    QHBoxLayout *layout = new QHBoxLayout();
+    layout->setMargin(0);
+    QProgressBar *bar = new QProgressBar();
+    bar->setRange(0, 1000);
+    bar->setTextVisible(false);
+    layout->addWidget(new QLabel(task->title()), 0);
+    layout->addWidget(bar, 1);
+    item->setLayout(layout);
+    _rows->addWidget(item);
+    _items.insert(task, item);
+    connect(task, SIGNAL(progress(int)), bar, SLOT(setValue(int)));
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    _tasks.insert(watcher, task);
+    connect(watcher, SIGNAL(finished()), this, SLOT(onTaskFinished()));
+    // Plots of samples are shown while the samples are drawn
+    if (QMainWindow *window = task->createProgressWindow())
+      window->show();
+    watcher->setFuture(QtConcurrent::run(&_pool, task, &OutputTask::run));
+  }
+  _cancel->setEnabled(true);
+  setVisible(isRunning());
+}
+
+void
+RunWidget::cancel() {
+  foreach (OutputTask *task, _tasks.values())
+    task->cancel();
+  _cancel->setEnabled(false);
+}
+
+void
+RunWidget::onTaskFinished() {
+  QFutureWatcher<bool> *watcher = dynamic_cast<QFutureWatcher<bool> *>(sender());
+  if (! _tasks.contains(watcher))
+    return;
+  OutputTask *task = _tasks.take(watcher);
+  delete _items.take(task);
+  watcher->deleteLater();
+
+  // Show the result as soon as the task is done
+  QMainWindow *window = 0;
+  if (watcher->result() && (window = task->createWindow())) {
+    window->show();
+  } else if (watcher->result()) {
+    QMessageBox::critical(0, tr("Cannot execute %1.").arg(task->title()),
+                          task->error().isEmpty() ? tr("Cannot create result window.") : task->error());
+  } else if (! task->isCanceled() && ! task->error().isEmpty()) {
+    QMessageBox::critical(0, tr("Cannot execute %1.").arg(task->title()), task->error());
+  }
+  delete task;
+
+  if (! isRunning()) {
+    setVisible(false);
+    emit finished();
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef RUNWIDGET_HH
+#define RUNWIDGET_HH
+
+#include <QWidget>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QHash>
+
+class OutputTask;
+class QVBoxLayout;
+class QPushButton;
+
+
+class RunWidget: public QWidget
+{
+  Q_OBJECT
+
+public:
+  RunWidget(QWidget *parent=0);
+  virtual ~RunWidget();
+
+  bool isRunning() const;
+  void start(const QList<OutputTask *> &tasks);
+
+public slots:
+  void cancel();
+
+signals:
+  void finished();
+
+protected slots:
+  void onTaskFinished();
+
+protected:
+  QThreadPool _pool;
+  QVBoxLayout *_rows;
+  QPushButton *_cancel;
+  QHash<QFutureWatcher<bool> *, OutputTask *> _tasks;
+  QHash<OutputTask *, QWidget *> _items;
+};
+
+#endif // RUNWIDGET_HH
@@ -0,0 +1,120 @@
+#include "samplecache.hh"
+#include <QFile>
+#include <QStandardPaths>
+#include <cstring>
+
+
+// Layout of a cache file: The header is followed by the samples stored row by row as native
+// doubles, hence new samples can be appended to an existing file.
+typedef struct {
+  char magic[4];
+  quint32 version;
+  quint64 columns;
+  quint64 rows;
+} SampleCacheHeader;
+
+static const char sampleCacheMagic[4] = {'S', 'B', 'B', 'S'};
+static const quint32 sampleCacheVersion = 1;
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXd;
+
+
+/* ******************************************************************************************** *
+ * Implementation of SampleCache
+ * ******************************************************************************************** */
+SampleCache::SampleCache(const QString &directory)
+  : _directory(directory)
+{
+  // pass...
+}
+
+QString
+SampleCache::defaultDirectory() {
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("samples");
+}
+
+QString
+SampleCache::filename(const QByteArray &key) const {
+  return _directory.filePath(QString::fromLatin1(key.toHex()) + ".bin");
+}
+
+size_t
+SampleCache::load(const QByteArray &key, Eigen::MatrixXd &samples) const {
+  return load(key, 0, samples);
+}
+
+size_t
+SampleCache::load(const QByteArray &key, size_t offset, Eigen::Ref<Eigen::MatrixXd> samples) const {
+  QFile file(filename(key));
+  if (! file.open(QIODevice::ReadOnly))
+    return 0;
+
+  SampleCacheHeader header;
+  if ((sizeof(header) != file.read((char *) &header, sizeof(header))) ||
+      memcmp(header.magic, sampleCacheMagic, 4) || (sampleCacheVersion != header.version) ||
+      (quint64(samples.cols()) != header.columns) || (header.rows <= quint64(offset)))
+    return 0;
+
+  // Rows are read starting at the given offset, as many as requested and available
+  size_t rows = std::min(size_t(header.rows)-offset, size_t(samples.rows()));
+  size_t rowsize = header.columns*sizeof(double);
+  if ((0 == rows) || (file.size() < qint64(sizeof(header) + (offset+rows)*rowsize)))
+    return 0;
+
+  uchar *data = file.map(sizeof(header) + offset*rowsize, rows*rowsize);
+  if (! data)
+    return 0;
+  samples.topRows(rows) = Eigen::Map<RowMajorMatrixXd>((double *) data, rows, header.columns);
+  file.unmap(data);
+  return rows;
+}
+
+bool
+SampleCache::store(const QByteArray &key, const Eigen::Ref<const Eigen::MatrixXd> &samples, size_t offset) {
+  if (offset >= size_t(samples.rows()))
+    return true;
+  // Append to an existing file only if it holds exactly the first offset rows, rewrite it otherwise
+  if (append(key, samples.bottomRows(samples.rows()-offset), offset))
+    return true;
+  return (0 != offset) && append(key, samples, 0);
+}
+
+bool
+SampleCache::append(const QByteArray &key, const Eigen::Ref<const Eigen::MatrixXd> &rows, size_t offset) {
+  if (! _directory.mkpath("."))
+    return false;
+
+  QFile file(filename(key));
+  if (! file.open(QIODevice::ReadWrite))
+    return false;
+
+  // The rows can only be appended if the file holds exactly the first offset rows. A new file
+  // is started only for rows starting at the very first one.
+  SampleCacheHeader header;
+  bool extend = (sizeof(header) == file.read((char *) &header, sizeof(header))) &&
+      (0 == memcmp(header.magic, sampleCacheMagic, 4)) && (sampleCacheVersion == header.version) &&
+      (quint64(rows.cols()) == header.columns) && (quint64(offset) == header.rows) &&
+      (file.size() == qint64(sizeof(header) + header.rows*header.columns*sizeof(double)));
+  if (! extend) {
+    if (offset)
+      return false;
+    file.resize(0);
+    memcpy(header.magic, sampleCacheMagic, 4);
+    header.version = sampleCacheVersion;
+    header.columns = rows.cols();
+    header.rows = 0;
+    file.seek(0);
+    if (sizeof(header) != file.write((const char *) &header, sizeof(header)))
+      return false;
+  }
+  header.rows = offset + rows.rows();
+
+  RowMajorMatrixXd data = rows;
+  file.seek(sizeof(header) + offset*header.columns*sizeof(double));
+  qint64 size = data.size()*sizeof(double);
+  if (size != file.write((const char *) data.data(), size))
+    return false;
+  // Update the header last, such that an interrupted write leaves a consistent file
+  file.seek(0);
+  return sizeof(header) == file.write((const char *) &header, sizeof(header));
+}
@@ -0,0 +1,29 @@
+#ifndef SAMPLECACHE_HH
+#define SAMPLECACHE_HH
+
+#include <QString>
+#include <QByteArray>
+#include <QDir>
+#include <Eigen/Eigen>
+
+
+class SampleCache
+{
+public:
+  SampleCache(const QString &directory=defaultDirectory());
+
+  size_t load(const QByteArray &key, Eigen::MatrixXd &samples) const;
+  size_t load(const QByteArray &key, size_t offset, Eigen::Ref<Eigen::MatrixXd> samples) const;
+  bool store(const QByteArray &key, const Eigen::Ref<const Eigen::MatrixXd> &samples, size_t offset);
+  bool append(const QByteArray &key, const Eigen::Ref<const Eigen::MatrixXd> &rows, size_t offset);
+
+  static QString defaultDirectory();
+
+protected:
+  QString filename(const QByteArray &key) const;
+
+protected:
+  QDir _directory;
+};
+
+#endif // SAMPLECACHE_HH